@@ -0,0 +1,291 @@
+/*
+ * Microbenchmarks for the hot pieces of the OCR pipeline, run over realistic frame sizes.
+ *
+ * Usage: ocr-benchmark [--filter <substring>] [--min-time <seconds>] [--format json|csv]
+ *                      [--output <file>]
+ *
+ * Results are written as JSON (default) or CSV with the median, minimum and mean time per call
+ * in microseconds, to compare runs before and after a change.
+ */
+
+#include <obs-module.h>
+#include <plugin-support.h>
+
+#include "frame-recording.h"
+#include "obs-utils.h"
+#include "preprocessing-pipeline.h"
+#include "text-render-helper.h"
+#include "text-utils.h"
+
+#include <QGuiApplication>
+
+#include <opencv2/core.hpp>
+#include <opencv2/core/utility.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <inja/inja.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+OBS_DECLARE_MODULE()
+
+namespace {
+
+struct benchmark_result {
+	std::string name;
+	std::string frame;
+	int iterations = 0;
+	double medianUs = 0.0;
+	double minUs = 0.0;
+	double meanUs = 0.0;
+};
+
+struct benchmark_options {
+	std::string filter;
+	double minTimeS = 0.5;
+};
+
+/**
+  * @brief Call fn until minTimeS passed (and at least 5 times), after a few warm-up calls
+*/
+bool run_benchmark(const benchmark_options &options, const std::string &name,
+		   const std::string &frame, const std::function<void()> &fn,
+		   std::vector<benchmark_result> &results)
+{
+	const std::string fullName = frame.empty() ? name : name + "@" + frame;
+	if (!options.filter.empty() && fullName.find(options.filter) == std::string::npos) {
+		return false;
+	}
+	for (int i = 0; i < 3; i++) {
+		fn();
+	}
+
+	std::vector<double> timesUs;
+	double totalUs = 0.0;
+	while ((totalUs < options.minTimeS * 1e6 || timesUs.size() < 5) &&
+	       timesUs.size() < 100000) {
+		const auto start = std::chrono::steady_clock::now();
+		fn();
+		const double us = std::chrono::duration<double, std::micro>(
+					  std::chrono::steady_clock::now() - start)
+					  .count();
+		timesUs.push_back(us);
+		totalUs += us;
+	}
+
+	benchmark_result result;
+	result.name = name;
+	result.frame = frame;
+	result.iterations = (int)timesUs.size();
+	result.meanUs = totalUs / (double)timesUs.size();
+	std::sort(timesUs.begin(), timesUs.end());
+	result.medianUs = timesUs[timesUs.size() / 2];
+	result.minUs = timesUs.front();
+	results.push_back(result);
+	fprintf(stderr, "%-40s %10.1f us median %10.1f us min (%d runs)\n", fullName.c_str(),
+		result.medianUs, result.minUs, result.iterations);
+	return true;
+}
+
+/**
+  * @brief A frame with noise and a few lines of dark text on a light background
+*/
+cv::Mat make_frame(cv::Size size)
+{
+	cv::Mat frame(size, CV_8UC4);
+	cv::randu(frame, cv::Scalar(190, 190, 190, 255), cv::Scalar(255, 255, 255, 256));
+	const double scale = (double)size.height / 360.0;
+	for (int line = 0; line < 4; line++) {
+		cv::putText(frame, "HOME 21 - 17 AWAY  Q4 02:35",
+			    cv::Point((int)(20 * scale), (int)((double)(80 + line * 80) * scale)),
+			    cv::FONT_HERSHEY_SIMPLEX, 1.2 * scale, cv::Scalar(20, 20, 20, 255),
+			    std::max(1, (int)(2 * scale)), cv::LINE_AA);
+	}
+	return frame;
+}
+
+void benchmark_frame_size(const benchmark_options &options, cv::Size size,
+			  std::vector<benchmark_result> &results)
+{
+	const std::string frameName =
+		std::to_string(size.width) + "x" + std::to_string(size.height);
+	const cv::Mat frame = make_frame(size);
+
+	auto pipeline_benchmark = [&](const std::string &name, const std::string &stages,
+				      int binarizationMode) {
+		PreprocessingPipeline pipeline;
+		preprocessing_params params;
+		params.binarizationMode = binarizationMode;
+		params.dilationIterations = 1;
+		params.rescaleTargetSize = std::max(35, size.height / 4);
+		pipeline.configure(parse_preprocessing_stages(stages), params);
+		run_benchmark(options, name, frameName, [&] { pipeline.process(frame); }, results);
+	};
+	pipeline_benchmark("gray", "gray", 0);
+	const char *modes[] = {"fixed", "adaptive_mean", "adaptive_gaussian", "triangle", "otsu"};
+	for (int mode = 1; mode <= 5; mode++) {
+		pipeline_benchmark(std::string("gray+threshold/") + modes[mode - 1],
+				   "gray, threshold", mode);
+	}
+	pipeline_benchmark("gray+dilate", "gray, dilate", 0);
+	pipeline_benchmark("gray+resize", "gray, resize", 0);
+	pipeline_benchmark("gray+resize+threshold/fixed", "gray, resize, threshold", 1);
+
+	// a frame where a small area changed, like a ticking clock
+	cv::Mat changed = frame.clone();
+	cv::rectangle(changed, cv::Rect(size.width / 2, size.height / 2, size.width / 20,
+					size.height / 20),
+		      cv::Scalar(0, 0, 255, 255), cv::FILLED);
+	run_benchmark(
+		options, "change_detection", frameName,
+		[&] { frame_changed(changed, frame, 5); }, results);
+
+	// the filter converts on capture and compares luminance
+	cv::Mat gray;
+	run_benchmark(
+		options, "capture_to_gray", frameName,
+		[&] { cv::cvtColor(frame, gray, cv::COLOR_BGRA2GRAY); }, results);
+	cv::Mat changedGray;
+	cv::cvtColor(changed, changedGray, cv::COLOR_BGRA2GRAY);
+	run_benchmark(
+		options, "change_detection/gray", frameName,
+		[&] { frame_changed(changedGray, gray, 5); }, results);
+
+	// the frame recorder stores the difference to the previous frame
+	cv::Mat difference;
+	cv::absdiff(changedGray, gray, difference);
+	std::vector<uint8_t> encoded;
+	run_benchmark(
+		options, "record/delta_rle", frameName,
+		[&] { frame_rle_encode(difference.data, difference.total(), encoded); }, results);
+
+	std::vector<OCRBox> boxes;
+	for (int i = 0; i < 12; i++) {
+		OCRBox box;
+		box.text = "WORD" + std::to_string(i);
+		box.box = cv::Rect((i % 4) * size.width / 4 + 10, (i / 4) * size.height / 3 + 10,
+				   size.width / 5, size.height / 10);
+		boxes.push_back(box);
+	}
+	run_benchmark(
+		options, "render_boxes", frameName,
+		[&] {
+			render_boxes_with_qtextdocument(boxes, (uint32_t)size.width,
+							(uint32_t)size.height, true);
+		},
+		results);
+}
+
+void benchmark_text(const benchmark_options &options, std::vector<benchmark_result> &results)
+{
+	CharacterBasedSmoothingFilter smoothing(8, 10);
+	const std::vector<std::string> readings = {"HOME 21", "HOME 2l", "H0ME 21", "HOME 21 "};
+	size_t reading = 0;
+	run_benchmark(
+		options, "smoothing/add_reading", "",
+		[&] { smoothing.add_reading(readings[reading++ % readings.size()]); }, results);
+
+	inja::Environment env;
+	const std::string text = "HOME 21 - 17 AWAY\nQ4 02:35";
+	run_benchmark(
+		options, "format_template/output", "",
+		[&] { format_text_with_template(env, text, "{{output}}", 0); }, results);
+	const std::string timed = "[{{frame_unix_ms}}] {{output}} ({{frame_time_ms}})";
+	run_benchmark(
+		options, "format_template/timestamps", "",
+		[&] { format_text_with_template(env, text, timed, 0); }, results);
+
+	std::string paragraph;
+	for (int i = 0; i < 8; i++) {
+		paragraph += "Player  " + std::to_string(i) + "\t 1250   points\r\n";
+	}
+	run_benchmark(
+		options, "flatten", "",
+		[&] {
+			std::string copy = paragraph;
+			flatten_text(copy);
+		},
+		results);
+}
+
+void write_results(std::ostream &out, const std::string &format,
+		   const std::vector<benchmark_result> &results)
+{
+	if (format == "csv") {
+		out << "name,frame,iterations,median_us,min_us,mean_us\n";
+		for (const benchmark_result &r : results) {
+			out << r.name << "," << r.frame << "," << r.iterations << "," << r.medianUs
+			    << "," << r.minUs << "," << r.meanUs << "\n";
+		}
+		return;
+	}
+	nlohmann::json json;
+	json["opencv_threads"] = cv::getNumThreads();
+	json["hardware_threads"] = std::thread::hardware_concurrency();
+	nlohmann::json entries = nlohmann::json::array();
+	for (const benchmark_result &r : results) {
+		nlohmann::json entry;
+		entry["name"] = r.name;
+		entry["frame"] = r.frame;
+		entry["iterations"] = r.iterations;
+		entry["median_us"] = r.medianUs;
+		entry["min_us"] = r.minUs;
+		entry["mean_us"] = r.meanUs;
+		entries.push_back(entry);
+	}
+	json["results"] = entries;
+	out << json.dump(2) << "\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	// render_boxes needs a GUI application for its fonts, but no display
+	if (getenv("QT_QPA_PLATFORM") == nullptr) {
+		qputenv("QT_QPA_PLATFORM", "offscreen");
+	}
+	QGuiApplication app(argc, argv);
+
+	benchmark_options options;
+	std::string format = "json";
+	std::string outputPath;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		const std::string option = argv[i];
+		if (option == "--filter") {
+			options.filter = argv[i + 1];
+		} else if (option == "--min-time") {
+			options.minTimeS = atof(argv[i + 1]);
+		} else if (option == "--format") {
+			format = argv[i + 1];
+		} else if (option == "--output") {
+			outputPath = argv[i + 1];
+		}
+	}
+
+	std::vector<benchmark_result> results;
+	// a typical crop, then the common canvas sizes
+	for (cv::Size size : {cv::Size(640, 360), cv::Size(1280, 720), cv::Size(1920, 1080),
+			      cv::Size(3840, 2160)}) {
+		benchmark_frame_size(options, size, results);
+	}
+	benchmark_text(options, results);
+
+	if (outputPath.empty()) {
+		write_results(std::cout, format, results);
+	} else {
+		std::ofstream out(outputPath);
+		write_results(out, format, results);
+	}
+	return 0;
+}
@@ -0,0 +1,217 @@
+/*
+ * Replays a frame recording made with the filter's "Record Frames" option through the plugin's
+ * preprocessing pipeline and recognition engine, with the settings that were recorded along
+ * with the frames, and reports what was read and how long it took.
+ *
+ * Usage: ocr-replay <recording.ocrrec> --tessdata <dir> [--output <results.json>]
+ *                   [--pipeline-only]
+ *
+ * The recorded frames are cropped and past change detection. Auto-ROI, auto-rescale and the
+ * text detection prepass depend on the results of earlier frames and aren't replayed.
+ */
+
+#include <obs-module.h>
+#include <plugin-support.h>
+
+#include "filter-data.h"
+#include "frame-recording.h"
+#include "ocr-engine.h"
+#include "ocr-settings.h"
+#include "preprocessing-pipeline.h"
+#include "text-utils.h"
+
+#include <opencv2/core.hpp>
+
+#include <inja/inja.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+OBS_DECLARE_MODULE()
+
+namespace {
+
+struct frame_result {
+	uint64_t timestampNs = 0;
+	std::string text;
+	int confidence = 0;
+	double preprocessMs = 0.0;
+	double recognizeMs = 0.0;
+	bool timedOut = false;
+};
+
+double milliseconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+		.count();
+}
+
+double percentile(std::vector<double> values, double p)
+{
+	if (values.empty()) {
+		return 0.0;
+	}
+	std::sort(values.begin(), values.end());
+	const size_t i = std::min(values.size() - 1, (size_t)(p * (double)(values.size() - 1)));
+	return values[i];
+}
+
+void print_latency(const char *name, const std::vector<double> &latencies)
+{
+	printf("%s: median %.2f ms, p99 %.2f ms, max %.2f ms\n", name,
+	       percentile(latencies, 0.5), percentile(latencies, 0.99),
+	       percentile(latencies, 1.0));
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s <recording.ocrrec> --tessdata <dir> "
+				"[--output <results.json>] [--pipeline-only]\n",
+			argv[0]);
+		return 2;
+	}
+	std::string tessdata = "data/tessdata";
+	std::string outputPath;
+	bool pipelineOnly = false;
+	for (int i = 2; i < argc; i++) {
+		const std::string option = argv[i];
+		if (option == "--pipeline-only") {
+			pipelineOnly = true;
+		} else if (option == "--tessdata" && i + 1 < argc) {
+			tessdata = argv[++i];
+		} else if (option == "--output" && i + 1 < argc) {
+			outputPath = argv[++i];
+		}
+	}
+
+	FrameRecordingReader reader;
+	if (!reader.open(argv[1])) {
+		fprintf(stderr, "Failed to open recording %s\n", argv[1]);
+		return 1;
+	}
+	printf("%zu frames in %s\n", reader.frame_count(), argv[1]);
+
+	filter_data tf;
+	tf.tesseractTraineddataFilepath = &tessdata[0];
+	tf.unique_id = "replay";
+
+	ocr_settings settings;
+	std::string settingsJson;
+	bool haveSettings = false;
+	std::unique_ptr<OcrEngine> engine;
+	PreprocessingPipeline pipeline;
+	cv::Mat frame;
+	std::vector<frame_result> results;
+
+	for (size_t i = 0; i < reader.frame_count(); i++) {
+		if (!reader.read_frame(i, frame)) {
+			fprintf(stderr, "Frame %zu is corrupt, stopping\n", i);
+			break;
+		}
+
+		const std::string json = reader.settings_json(i);
+		if (!haveSettings || json != settingsJson) {
+			ocr_settings next;
+			obs_data_t *data = obs_data_create_from_json(json.c_str());
+			if (data != nullptr) {
+				read_ocr_settings(data, next);
+				obs_data_release(data);
+			} else {
+				fprintf(stderr,
+					"Frame %zu has no recorded settings, using defaults\n", i);
+			}
+			if (!pipelineOnly && (!engine || ocr_engine_changed(settings, next))) {
+				const auto start = std::chrono::steady_clock::now();
+				engine = create_ocr_engine(&tf, next);
+				if (!engine) {
+					fprintf(stderr, "No OCR engine for frame %zu\n", i);
+					tf.tesseractTraineddataFilepath = nullptr;
+					return 1;
+				}
+				engine->warm_up();
+				printf("Loaded %s (%s) in %.0f ms\n", engine->name(),
+				       next.language.c_str(), milliseconds_since(start));
+			}
+			if (engine) {
+				engine->configure(next);
+			}
+			pipeline.configure(next.preprocessingStages, next.preprocessing);
+			settings = next;
+			settingsJson = json;
+			haveSettings = true;
+		}
+
+		frame_result result;
+		result.timestampNs = reader.timestamp_ns(i);
+		auto start = std::chrono::steady_clock::now();
+		ocr_request request;
+		request.image = pipeline.process(frame);
+		request.scale = (double)request.image.cols / (double)frame.cols;
+		request.deadlineMs = settings.recognition_deadline_ms;
+		result.preprocessMs = milliseconds_since(start);
+
+		if (!pipelineOnly) {
+			start = std::chrono::steady_clock::now();
+			ocr_engine_result recognized;
+			engine->recognize(request, settings, recognized);
+			result.recognizeMs = milliseconds_since(start);
+			result.text = strip(recognized.text);
+			result.confidence = recognized.confidence;
+			result.timedOut = recognized.timedOut;
+			printf("%zu %.3f s %.1f ms%s: %s\n", i, (double)result.timestampNs / 1e9,
+			       result.recognizeMs, result.timedOut ? " (deadline)" : "",
+			       result.text.c_str());
+		}
+		results.push_back(result);
+	}
+	// languages loaded on demand read the model folder from the filter until the engine is
+	// gone, and the filter doesn't own it
+	engine.reset();
+	tf.tesseractTraineddataFilepath = nullptr;
+
+	std::vector<double> preprocessLatencies;
+	std::vector<double> recognizeLatencies;
+	for (const frame_result &result : results) {
+		preprocessLatencies.push_back(result.preprocessMs);
+		recognizeLatencies.push_back(result.recognizeMs);
+	}
+	printf("%zu frames replayed\n", results.size());
+	print_latency("preprocessing", preprocessLatencies);
+	if (!pipelineOnly) {
+		print_latency("recognition", recognizeLatencies);
+	}
+
+	if (!outputPath.empty()) {
+		nlohmann::json frames = nlohmann::json::array();
+		for (const frame_result &result : results) {
+			nlohmann::json entry;
+			entry["timestamp_ns"] = result.timestampNs;
+			entry["preprocess_ms"] = result.preprocessMs;
+			if (!pipelineOnly) {
+				entry["text"] = result.text;
+				entry["confidence"] = result.confidence;
+				entry["recognize_ms"] = result.recognizeMs;
+				entry["timed_out"] = result.timedOut;
+			}
+			frames.push_back(entry);
+		}
+		std::ofstream output(outputPath);
+		if (!output.is_open()) {
+			fprintf(stderr, "Failed to write %s\n", outputPath.c_str());
+			return 1;
+		}
+		nlohmann::json replay;
+		replay["recording"] = argv[1];
+		replay["frames"] = frames;
+		output << replay.dump(2) << "\n";
+	}
+	return 0;
+}
@@ -67,6 +67,17 @@ FetchContent_Declare(
 FetchContent_MakeAvailable(opencv)
 
 add_library(OpenCV INTERFACE)
+# the predefined packages only have core and imgproc, the dnn module needs a custom OpenCV build
+if(ENABLE_OPENCV_DNN)
+  if(MSVC)
+    target_link_libraries(
+      OpenCV INTERFACE ${opencv_SOURCE_DIR}/x64/vc17/staticlib/opencv_dnn481.lib
+                       ${opencv_SOURCE_DIR}/x64/vc17/staticlib/libprotobuf.lib)
+  else()
+    target_link_libraries(OpenCV INTERFACE ${opencv_SOURCE_DIR}/lib/libopencv_dnn.a
+                                           ${opencv_SOURCE_DIR}/lib/opencv4/3rdparty/liblibprotobuf.a)
+  endif()
+endif()
 if(MSVC)
   target_link_libraries(
     OpenCV
@@ -0,0 +1,99 @@
+/*
+ * Test client for the OCR result publisher.
+ *
+ * Usage: ocr-reader-test <name> [--socket]
+ *
+ * Prints every result the filter publishing under name produces, with its frame-to-read
+ * latency. The name is the filter's publish name, or the id the OBS log shows when it's empty.
+ * With --socket the JSON lines of the Unix socket are printed instead.
+ */
+
+#include "ocr-result-reader.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+static int read_shared_memory(const std::string &name)
+{
+	OcrResultReader reader;
+	while (!reader.open(name)) {
+		fprintf(stderr, "Waiting for the filter to publish '%s'...\n", name.c_str());
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+	}
+	printf("Reading results of '%s'\n", name.c_str());
+
+	ocr_reader_result result;
+	uint64_t dropped = 0;
+	for (;;) {
+		if (!reader.next(result, &dropped)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			continue;
+		}
+		if (dropped > 0) {
+			printf("(%llu results dropped)\n", (unsigned long long)dropped);
+		}
+		const uint64_t now = ocr_reader_now_ns();
+		printf("#%llu conf %d boxes %zu frame->publish %.1f ms frame->read %.1f ms: %s\n",
+		       (unsigned long long)result.sequence, result.confidence, result.boxes.size(),
+		       (double)(result.publish_timestamp_ns - result.frame_timestamp_ns) / 1e6,
+		       (double)(now - result.frame_timestamp_ns) / 1e6, result.text.c_str());
+		fflush(stdout);
+	}
+}
+
+static int read_socket(const std::string &name)
+{
+#ifdef _WIN32
+	fprintf(stderr, "The result socket is not available on Windows\n");
+	return 1;
+#else
+	const std::string path = ocr_ring_socket_path(name);
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+		fprintf(stderr, "Failed to connect to %s\n", path.c_str());
+		return 1;
+	}
+	printf("Reading results from %s\n", path.c_str());
+
+	char buffer[4096];
+	ssize_t received;
+	while ((received = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+		fwrite(buffer, 1, (size_t)received, stdout);
+		fflush(stdout);
+	}
+	close(fd);
+	fprintf(stderr, "The filter closed the connection\n");
+	return 0;
+#endif
+}
+
+int main(int argc, char **argv)
+{
+	std::string name;
+	bool use_socket = false;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--socket") == 0) {
+			use_socket = true;
+		} else {
+			name = argv[i];
+		}
+	}
+	if (name.empty()) {
+		fprintf(stderr, "Usage: %s <name> [--socket]\n", argv[0]);
+		return 2;
+	}
+	return use_socket ? read_socket(name) : read_shared_memory(name);
+}
@@ -0,0 +1,161 @@
+#include "ocr-result-reader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+uint64_t ocr_reader_now_ns()
+{
+	// steady_clock is the clock os_gettime_ns reads on every platform OBS supports:
+	// CLOCK_MONOTONIC on Linux, QueryPerformanceCounter on Windows, the uptime clock on macOS
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		       std::chrono::steady_clock::now().time_since_epoch())
+		.count();
+}
+
+OcrResultReader::~OcrResultReader()
+{
+	close();
+}
+
+bool OcrResultReader::open(const std::string &name)
+{
+	close();
+	const std::string shm_name = ocr_ring_shm_name(name);
+	const size_t size = sizeof(ocr_ring_header);
+	const void *memory = nullptr;
+#ifdef _WIN32
+	mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, shm_name.c_str());
+	if (mapping == nullptr) {
+		return false;
+	}
+	memory = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, size);
+#else
+	shm_fd = shm_open(shm_name.c_str(), O_RDONLY, 0);
+	struct stat info;
+	if (shm_fd < 0 || fstat(shm_fd, &info) != 0 || (size_t)info.st_size < size) {
+		close();
+		return false;
+	}
+	memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, shm_fd, 0);
+	if (memory == MAP_FAILED) {
+		memory = nullptr;
+	}
+#endif
+	if (memory == nullptr) {
+		close();
+		return false;
+	}
+
+	ring = static_cast<const ocr_ring_header *>(memory);
+	if (ring->magic != OCR_RING_MAGIC || ring->version != OCR_RING_VERSION ||
+	    ring->capacity != OCR_RING_CAPACITY || ring->record_size != sizeof(ocr_ring_record)) {
+		close();
+		return false;
+	}
+	// start with the results published from now on
+	last_sequence = ring->write_sequence.load(std::memory_order_acquire);
+	return true;
+}
+
+void OcrResultReader::close()
+{
+#ifdef _WIN32
+	if (ring != nullptr) {
+		UnmapViewOfFile(ring);
+	}
+	if (mapping != nullptr) {
+		CloseHandle(mapping);
+		mapping = nullptr;
+	}
+#else
+	if (ring != nullptr) {
+		munmap(const_cast<ocr_ring_header *>(ring), sizeof(ocr_ring_header));
+	}
+	if (shm_fd >= 0) {
+		::close(shm_fd);
+		shm_fd = -1;
+	}
+#endif
+	ring = nullptr;
+	last_sequence = 0;
+}
+
+bool OcrResultReader::read_record(uint64_t sequence, ocr_reader_result &result) const
+{
+	const ocr_ring_record &record = ring->records[sequence % OCR_RING_CAPACITY];
+	const uint64_t lock = record.lock.load(std::memory_order_acquire);
+	if (lock != 2 * sequence) {
+		// being written, or already overwritten by a later result
+		return false;
+	}
+
+	ocr_reader_result copy;
+	copy.sequence = record.sequence;
+	copy.frame_timestamp_ns = record.frame_timestamp_ns;
+	copy.publish_timestamp_ns = record.publish_timestamp_ns;
+	copy.confidence = record.confidence;
+	const uint32_t text_length = std::min(record.text_length, OCR_RING_TEXT_SIZE - 1);
+	copy.text.assign(record.text, text_length);
+	const uint32_t box_count = std::min(record.box_count, OCR_RING_MAX_BOXES);
+	copy.boxes.assign(record.boxes, record.boxes + box_count);
+
+	// the copy is only valid if the writer didn't touch the record meanwhile
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (record.lock.load(std::memory_order_relaxed) != lock) {
+		return false;
+	}
+	result = std::move(copy);
+	return true;
+}
+
+bool OcrResultReader::next(ocr_reader_result &result, uint64_t *dropped)
+{
+	if (ring == nullptr) {
+		return false;
+	}
+	const uint64_t write_sequence = ring->write_sequence.load(std::memory_order_acquire);
+	if (write_sequence < last_sequence) {
+		// the filter restarted publishing, its sequence started over
+		last_sequence = 0;
+	}
+
+	uint64_t sequence = last_sequence + 1;
+	if (write_sequence >= OCR_RING_CAPACITY && sequence <= write_sequence - OCR_RING_CAPACITY) {
+		sequence = write_sequence - OCR_RING_CAPACITY + 1;
+	}
+	// a record may be overwritten while it is read, move on to the next one then
+	for (; sequence <= write_sequence; sequence++) {
+		if (read_record(sequence, result)) {
+			if (dropped != nullptr) {
+				*dropped = sequence - last_sequence - 1;
+			}
+			last_sequence = sequence;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool OcrResultReader::latest(ocr_reader_result &result)
+{
+	if (ring == nullptr) {
+		return false;
+	}
+	const uint64_t write_sequence = ring->write_sequence.load(std::memory_order_acquire);
+	if (write_sequence == last_sequence || write_sequence == 0 ||
+	    !read_record(write_sequence, result)) {
+		return false;
+	}
+	last_sequence = write_sequence;
+	return true;
+}
@@ -0,0 +1,72 @@
+#ifndef OCR_RESULT_READER_H
+#define OCR_RESULT_READER_H
+
+#include "ocr-result-ring.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+  * @brief One result read from the ring. Boxes are in source pixels, timestamps on the OBS clock
+  * (see ocr_reader_now_ns).
+*/
+struct ocr_reader_result {
+	uint64_t sequence = 0;
+	uint64_t frame_timestamp_ns = 0;
+	uint64_t publish_timestamp_ns = 0;
+	int confidence = 0;
+	std::string text;
+	std::vector<ocr_ring_box> boxes;
+};
+
+/**
+  * @brief Current time on the clock the plugin stamps its results with
+*/
+uint64_t ocr_reader_now_ns();
+
+/**
+  * @brief Reads the results an OCR filter publishes to shared memory. Never blocks the filter:
+  * a reader that falls more than a ring's worth behind skips the overwritten results.
+*/
+class OcrResultReader {
+public:
+	OcrResultReader() = default;
+	~OcrResultReader();
+	OcrResultReader(const OcrResultReader &) = delete;
+	OcrResultReader &operator=(const OcrResultReader &) = delete;
+
+	/**
+	  * @brief Attach to the ring of the filter publishing under name
+	  * @return false if the filter isn't publishing or the ring has an unknown layout
+	*/
+	bool open(const std::string &name);
+	void close();
+	bool is_open() const { return ring != nullptr; }
+
+	/**
+	  * @brief Read the oldest result not read yet
+	  * @param dropped Set to the number of results that were overwritten before they were read
+	  * @return false if there is no new result
+	*/
+	bool next(ocr_reader_result &result, uint64_t *dropped = nullptr);
+
+	/**
+	  * @brief Read the newest result, skipping everything before it
+	  * @return false if there is no new result
+	*/
+	bool latest(ocr_reader_result &result);
+
+private:
+	bool read_record(uint64_t sequence, ocr_reader_result &result) const;
+
+	const ocr_ring_header *ring = nullptr;
+	uint64_t last_sequence = 0;
+#ifdef _WIN32
+	void *mapping = nullptr;
+#else
+	int shm_fd = -1;
+#endif
+};
+
+#endif /* OCR_RESULT_READER_H */
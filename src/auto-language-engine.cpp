@@ -0,0 +1,318 @@
+#include "ocr-engine.h"
+#include "filter-data.h"
+#include "plugin-support.h"
+#include "text-utils.h"
+
+#include <obs-module.h>
+
+#include <tesseract/baseapi.h>
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+// the script each bundled model reads, as named by Tesseract's script detection
+const std::map<std::string, std::string> LANGUAGE_SCRIPTS = {
+	{"eng", "Latin"},        {"deu", "Latin"},      {"fra", "Latin"},
+	{"spa", "Latin"},        {"ita", "Latin"},      {"por", "Latin"},
+	{"scoreboard", "Latin"}, {"daktronics", "Latin"}, {"rus", "Cyrillic"},
+	{"ara", "Arabic"},       {"hin", "Devanagari"}, {"jpn", "Japanese"},
+	{"chi_sim", "Han"},
+};
+
+// frames between two script detections while the text reads confidently, and after a frame
+// that didn't
+constexpr int SCRIPT_DETECTION_INTERVAL = 30;
+constexpr int SCRIPT_RETRY_INTERVAL = 5;
+
+// whether script detection can run, found out by the first engine that tries
+enum class osd_support { Unknown, Available, Unavailable };
+std::mutex osdSupportMutex;
+osd_support osdSupport = osd_support::Unknown;
+
+/**
+  * @brief Load the orientation and script detection model.
+  *
+  * osd.traineddata isn't among the bundled models and only runs on the legacy engine, so this
+  * is checked and logged once per session. Without it languages are only switched round-robin
+  * on low confidence reads.
+  * @return nullptr if script detection isn't available
+*/
+tesseract::TessBaseAPI *create_script_detector(const char *tessdataPath)
+{
+	std::lock_guard<std::mutex> lock(osdSupportMutex);
+	if (osdSupport == osd_support::Unavailable || tessdataPath == nullptr) {
+		return nullptr;
+	}
+	if (!std::filesystem::exists(std::filesystem::path(tessdataPath) / "osd.traineddata")) {
+		obs_log(LOG_INFO, "No osd.traineddata in %s, automatic language selection will "
+				  "switch languages on low confidence only",
+			tessdataPath);
+		osdSupport = osd_support::Unavailable;
+		return nullptr;
+	}
+	// script detection only exists in the legacy engine
+	tesseract::TessBaseAPI *osd = new tesseract::TessBaseAPI();
+	if (osd->Init(tessdataPath, "osd", tesseract::OEM_TESSERACT_ONLY) != 0) {
+		obs_log(LOG_WARNING, "Failed to load the script detection model, the legacy engine "
+				     "may be missing. Switching languages on low confidence only");
+		delete osd;
+		osdSupport = osd_support::Unavailable;
+		return nullptr;
+	}
+	osd->SetPageSegMode(tesseract::PSM_OSD_ONLY);
+	osdSupport = osd_support::Available;
+	return osd;
+}
+
+bool script_matches(const std::string &language, const std::string &script)
+{
+	const auto it = LANGUAGE_SCRIPTS.find(language);
+	if (it == LANGUAGE_SCRIPTS.end()) {
+		return false;
+	}
+	// Japanese text mixes kana and kanji
+	return it->second == script ||
+	       (it->second == "Japanese" &&
+		(script == "Hiragana" || script == "Katakana" || script == "Han"));
+}
+
+/**
+  * @brief Routes every frame to the single-language Tesseract engine for the script on screen.
+  *
+  * The script is detected with Tesseract's orientation and script detection when osd.traineddata
+  * is installed, every few frames and after a read below the confidence threshold. Without it,
+  * a low confidence read moves on to the next candidate language. Engines are loaded on first
+  * use on a background thread, the current one keeps serving meanwhile, and stay loaded.
+*/
+class AutoLanguageEngine : public OcrEngine {
+public:
+	AutoLanguageEngine(filter_data *tf_, const ocr_settings &settings,
+			   std::vector<std::string> languages_, tesseract::TessBaseAPI *osd_)
+		: tf(tf_),
+		  loadSettings(settings),
+		  languages(std::move(languages_)),
+		  osd(osd_)
+	{
+	}
+
+	~AutoLanguageEngine() override
+	{
+		if (loading && loading->thread.joinable()) {
+			loading->thread.join();
+		}
+		if (osd != nullptr) {
+			osd->End();
+			delete osd;
+		}
+	}
+
+	const char *name() const override { return "Tesseract (automatic language)"; }
+
+	void add_engine(const std::string &language, std::unique_ptr<OcrEngine> engine)
+	{
+		engines[language] = std::move(engine);
+		if (activeLanguage.empty()) {
+			activeLanguage = language;
+		}
+	}
+
+	void configure(const ocr_settings &settings) override
+	{
+		loadSettings = settings;
+		for (auto &[language, engine] : engines) {
+			engine->configure(settings);
+		}
+	}
+
+	bool recognize(const ocr_request &request, const ocr_settings &settings,
+		       ocr_engine_result &result) override
+	{
+		poll_load();
+
+		// something was read, but poorly. An empty frame says nothing about the language
+		const bool misread = lastConfidence > 0 && lastConfidence < settings.conf_threshold;
+		framesSinceDetection++;
+		if (framesSinceDetection >=
+		    (misread ? SCRIPT_RETRY_INTERVAL : SCRIPT_DETECTION_INTERVAL)) {
+			framesSinceDetection = 0;
+			if (osd != nullptr) {
+				select_by_script(request.image);
+			} else if (misread) {
+				select_next();
+			}
+		}
+
+		const bool ok = engines.at(activeLanguage)->recognize(request, settings, result);
+		lastConfidence = result.confidence;
+		return ok;
+	}
+
+	void warm_up() override
+	{
+		for (auto &[language, engine] : engines) {
+			engine->warm_up();
+		}
+	}
+
+private:
+	struct language_load {
+		std::thread thread;
+		std::string language;
+		std::atomic<bool> done{false};
+		std::unique_ptr<OcrEngine> engine;
+	};
+
+	void select_by_script(const cv::Mat &image)
+	{
+		osd->SetImage(image.data, image.cols, image.rows, image.channels(),
+			      (int)image.step);
+		int orientation = 0;
+		float orientationConfidence = 0.0f;
+		const char *script = nullptr;
+		float scriptConfidence = 0.0f;
+		if (!osd->DetectOrientationScript(&orientation, &orientationConfidence, &script,
+						  &scriptConfidence) ||
+		    script == nullptr) {
+			// too little text to tell
+			return;
+		}
+		if (script_matches(activeLanguage, script)) {
+			return;
+		}
+		for (const std::string &language : languages) {
+			if (script_matches(language, script)) {
+				obs_log(LOG_INFO, "Detected %s script (confidence %.1f), using %s",
+					script, scriptConfidence, language.c_str());
+				switch_to(language);
+				return;
+			}
+		}
+		obs_log(LOG_DEBUG, "Detected %s script, none of the languages matches", script);
+	}
+
+	void select_next()
+	{
+		const auto it = std::find(languages.begin(), languages.end(), activeLanguage);
+		size_t next = 0;
+		if (it != languages.end()) {
+			next = ((size_t)(it - languages.begin()) + 1) % languages.size();
+		}
+		if (languages[next] != activeLanguage) {
+			obs_log(LOG_DEBUG, "Low confidence, trying %s", languages[next].c_str());
+			switch_to(languages[next]);
+		}
+	}
+
+	void switch_to(const std::string &language)
+	{
+		if (engines.count(language) > 0) {
+			activeLanguage = language;
+			return;
+		}
+		// load it in the background, it takes over once loaded
+		wantedLanguage = language;
+		if (loading) {
+			return;
+		}
+		loading = std::make_unique<language_load>();
+		loading->language = language;
+		ocr_settings settings = loadSettings;
+		settings.language = language;
+		language_load *load = loading.get();
+		filter_data *filter = tf;
+		load->thread = std::thread([load, filter, settings]() {
+			load->engine = create_tesseract_engine(filter, settings);
+			if (load->engine) {
+				load->engine->warm_up();
+			}
+			load->done = true;
+		});
+	}
+
+	void poll_load()
+	{
+		if (!loading || !loading->done) {
+			return;
+		}
+		loading->thread.join();
+		const std::string language = loading->language;
+		if (loading->engine) {
+			loading->engine->configure(loadSettings);
+			engines[language] = std::move(loading->engine);
+			obs_log(LOG_INFO, "Loaded %s for automatic language selection",
+				language.c_str());
+		} else {
+			// don't keep trying a model that can't be loaded
+			languages.erase(std::remove(languages.begin(), languages.end(), language),
+					languages.end());
+		}
+		loading.reset();
+		if (wantedLanguage == language && engines.count(language) > 0) {
+			activeLanguage = language;
+		} else if (!wantedLanguage.empty() && engines.count(wantedLanguage) == 0 &&
+			   std::find(languages.begin(), languages.end(), wantedLanguage) !=
+				   languages.end()) {
+			switch_to(wantedLanguage);
+		}
+	}
+
+	filter_data *tf;
+	ocr_settings loadSettings;
+	// candidates in order of preference
+	std::vector<std::string> languages;
+	tesseract::TessBaseAPI *osd;
+	std::map<std::string, std::unique_ptr<OcrEngine>> engines;
+	std::string activeLanguage;
+	std::string wantedLanguage;
+	std::unique_ptr<language_load> loading;
+	// detect on the first frame
+	int framesSinceDetection = SCRIPT_DETECTION_INTERVAL;
+	int lastConfidence = 0;
+};
+
+} // namespace
+
+std::vector<std::string> parse_auto_languages(const std::string &spec)
+{
+	std::vector<std::string> languages;
+	std::string normalized = spec;
+	std::replace(normalized.begin(), normalized.end(), ',', ' ');
+	std::istringstream stream(normalized);
+	std::string language;
+	while (stream >> language) {
+		if (std::find(languages.begin(), languages.end(), language) == languages.end()) {
+			languages.push_back(language);
+		}
+	}
+	return languages;
+}
+
+std::unique_ptr<OcrEngine> create_auto_language_engine(filter_data *tf,
+						       const ocr_settings &settings)
+{
+	const std::vector<std::string> languages = parse_auto_languages(settings.auto_languages);
+	if (languages.empty()) {
+		obs_log(LOG_ERROR, "Automatic language selection needs at least one language");
+		return nullptr;
+	}
+
+	// the first language is loaded right away, the others when their script shows up
+	ocr_settings first = settings;
+	first.language = languages.front();
+	std::unique_ptr<OcrEngine> engine = create_tesseract_engine(tf, first);
+	if (!engine) {
+		return nullptr;
+	}
+
+	tesseract::TessBaseAPI *osd = create_script_detector(tf->tesseractTraineddataFilepath);
+	auto autoEngine = std::make_unique<AutoLanguageEngine>(tf, settings, languages, osd);
+	autoEngine->add_engine(first.language, std::move(engine));
+	return autoEngine;
+}
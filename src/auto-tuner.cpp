@@ -0,0 +1,494 @@
+#include "auto-tuner.h"
+#include "consts.h"
+#include "ocr-engine.h"
+#include "model-manager.h"
+#include "plugin-support.h"
+#include "tesseract-ocr-utils.h"
+#include "text-utils.h"
+#include "preprocessing-pipeline.h"
+#include "cpu-budget.h"
+
+#include <obs-module.h>
+
+#include <QImage>
+#include <QString>
+
+#include <opencv2/core.hpp>
+
+#include <tesseract/baseapi.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+struct tuner_sample {
+	std::string name;
+	cv::Mat imageGray;
+	std::string expected;
+};
+
+struct tuner_config {
+	int binarizationMode;
+	int binarizationThreshold;
+	int binarizationBlockSize;
+	int dilationIterations;
+	bool rescaleImage;
+	int rescaleTargetSize;
+	int pageSegmentationMode;
+	std::string charWhitelist;
+};
+
+struct tuner_result {
+	bool valid = false;
+	float accuracy = 0.0f;
+	double medianLatencyMs = 0.0;
+};
+
+struct tuner_job {
+	std::string tessdataPath;
+	std::string language;
+	std::string samplesFolder;
+	int confThreshold;
+	float targetAccuracy;
+	// the configured stage order, empty for the one the binarization/dilation/rescale options
+	// imply. Only the stage parameters are searched, not the order
+	std::vector<PreprocessingStage> stages;
+	// the configured values of the parameters that aren't searched
+	preprocessing_params baseParams;
+	std::vector<tuner_sample> samples;
+	std::vector<tuner_config> configs;
+	std::vector<tuner_result> results;
+};
+
+static std::string tuner_samples_folder(filter_data *tf)
+{
+	obs_data_t *settings = obs_source_get_settings(tf->source);
+	std::string folder = obs_data_get_string(settings, "tuner_samples_folder");
+	obs_data_release(settings);
+	return folder;
+}
+
+bool capture_tuner_sample(filter_data *tf)
+{
+	const std::string folder = tuner_samples_folder(tf);
+	if (folder.empty()) {
+		obs_log(LOG_WARNING, "Auto-tuner: no samples folder selected");
+		return false;
+	}
+
+	cv::Mat imageGray;
+	{
+		std::lock_guard<std::mutex> lock(tf->inputGrayLock);
+		if (tf->inputGray.empty()) {
+			obs_log(LOG_WARNING, "Auto-tuner: no frame available to capture");
+			return false;
+		}
+		// already cropped on capture
+		imageGray = tf->inputGray.clone();
+	}
+
+	std::filesystem::create_directories(folder);
+	const long long timestamp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+					       std::chrono::system_clock::now().time_since_epoch())
+					       .count();
+	const std::string stem = folder + "/sample-" + std::to_string(timestamp_ms);
+
+	// the filter only keeps the luminance of the frames
+	QImage image(imageGray.data, imageGray.cols, imageGray.rows, (int)imageGray.step,
+		     QImage::Format_Grayscale8);
+	if (!image.save(QString::fromStdString(stem + ".png"))) {
+		obs_log(LOG_ERROR, "Auto-tuner: failed to save sample %s.png", stem.c_str());
+		return false;
+	}
+
+	// seed the expected text with the current output, to be corrected by the user
+	obs_data_t *settings = obs_source_get_settings(tf->source);
+	std::ofstream expected_file(stem + ".txt");
+	expected_file << obs_data_get_string(settings, "current_output");
+	expected_file.close();
+	obs_data_release(settings);
+
+	obs_log(LOG_INFO, "Auto-tuner: captured sample %s.png", stem.c_str());
+	return true;
+}
+
+static std::vector<tuner_sample> load_tuner_samples(const std::string &folder)
+{
+	std::vector<tuner_sample> samples;
+	if (!std::filesystem::is_directory(folder)) {
+		return samples;
+	}
+	for (const auto &entry : std::filesystem::directory_iterator(folder)) {
+		if (entry.path().extension() != ".png") {
+			continue;
+		}
+		std::filesystem::path expected_path = entry.path();
+		expected_path.replace_extension(".txt");
+		std::ifstream expected_file(expected_path);
+		if (!expected_file.is_open()) {
+			obs_log(LOG_WARNING, "Auto-tuner: no expected text for %s, skipping",
+				entry.path().filename().string().c_str());
+			continue;
+		}
+		std::stringstream expected;
+		expected << expected_file.rdbuf();
+
+		QImage image(QString::fromStdString(entry.path().string()));
+		if (image.isNull()) {
+			continue;
+		}
+		// the same single channel input the filter's pipeline gets
+		image = image.convertToFormat(QImage::Format_Grayscale8);
+		tuner_sample sample;
+		sample.name = entry.path().filename().string();
+		sample.imageGray = cv::Mat(image.height(), image.width(), CV_8UC1, image.bits(),
+					   (size_t)image.bytesPerLine())
+					   .clone();
+		sample.expected = expected.str();
+		samples.push_back(sample);
+	}
+	return samples;
+}
+
+/**
+  * @brief Whether the options of a stage are read: always with the legacy order (no stage list),
+  * otherwise only if the stage is in the list
+*/
+static bool stage_in_use(const std::vector<PreprocessingStage> &stages, PreprocessingStage stage)
+{
+	return stages.empty() || std::find(stages.begin(), stages.end(), stage) != stages.end();
+}
+
+static std::vector<tuner_config> build_search_space(obs_data_t *settings,
+						    const std::vector<PreprocessingStage> &stages)
+{
+	struct binarization_option {
+		int mode;
+		int threshold;
+		int blockSize;
+	};
+	// the options of a stage that isn't in the list don't change the pipeline, searching them
+	// would only measure the same configuration again. They are set to "off" so that the
+	// report describes what ran
+	std::vector<binarization_option> binarizations = {{0, 127, 15}};
+	if (stage_in_use(stages, PreprocessingStage::Threshold)) {
+		binarizations = {
+			{0, 127, 15}, {1, 96, 15},  {1, 127, 15}, {1, 160, 15}, {2, 127, 15},
+			{2, 127, 31}, {3, 127, 15}, {3, 127, 31}, {4, 127, 15}, {5, 127, 15},
+		};
+	}
+
+	std::vector<int> dilations = {0};
+	if (stage_in_use(stages, PreprocessingStage::Dilate)) {
+		dilations.push_back(1);
+	}
+
+	// 0 is no resize, a configured resize stage always runs
+	std::vector<int> rescaleSizes;
+	const int currentRescale = (int)obs_data_get_int(settings, "rescale_target_size");
+	if (stages.empty()) {
+		rescaleSizes = {0, 35};
+		if (obs_data_get_bool(settings, "rescale_image") && currentRescale != 35) {
+			rescaleSizes.push_back(currentRescale);
+		}
+	} else if (stage_in_use(stages, PreprocessingStage::Resize)) {
+		rescaleSizes = {35};
+		if (currentRescale > 0 && currentRescale != 35) {
+			rescaleSizes.push_back(currentRescale);
+		}
+	} else {
+		rescaleSizes = {0};
+	}
+
+	std::vector<int> psms = {(int)obs_data_get_int(settings, "page_segmentation_mode")};
+	for (int psm : {(int)tesseract::PSM_SINGLE_LINE, (int)tesseract::PSM_SINGLE_BLOCK,
+			(int)tesseract::PSM_SPARSE_TEXT}) {
+		if (std::find(psms.begin(), psms.end(), psm) == psms.end()) {
+			psms.push_back(psm);
+		}
+	}
+
+	std::vector<std::string> whitelists = {obs_data_get_string(settings, "char_whitelist")};
+	if (!whitelists[0].empty()) {
+		whitelists.push_back("");
+	}
+
+	std::vector<tuner_config> configs;
+	tuner_config config;
+	for (const binarization_option &binarization : binarizations) {
+		config.binarizationMode = binarization.mode;
+		config.binarizationThreshold = binarization.threshold;
+		config.binarizationBlockSize = binarization.blockSize;
+		for (int dilation : dilations) {
+			config.dilationIterations = dilation;
+			for (int rescale : rescaleSizes) {
+				config.rescaleImage = rescale > 0;
+				config.rescaleTargetSize = rescale > 0 ? rescale : 35;
+				for (int psm : psms) {
+					config.pageSegmentationMode = psm;
+					for (const std::string &whitelist : whitelists) {
+						config.charWhitelist = whitelist;
+						configs.push_back(config);
+					}
+				}
+			}
+		}
+	}
+	return configs;
+}
+
+static void tuner_worker(tuner_job &job, std::atomic<size_t> &next_config,
+			 const std::atomic<bool> &cancel)
+{
+	uint64_t budget_version = 0;
+	apply_cpu_budget_to_current_thread(budget_version);
+
+	tesseract::TessBaseAPI api;
+	if (api.Init(job.tessdataPath.c_str(), job.language.c_str(), tesseract::OEM_LSTM_ONLY) !=
+	    0) {
+		obs_log(LOG_ERROR, "Auto-tuner: failed to initialize tesseract model");
+		return;
+	}
+
+	PreprocessingPipeline pipeline;
+	std::vector<double> latencies;
+	for (size_t i = next_config++; i < job.configs.size() && !cancel; i = next_config++) {
+		const tuner_config &config = job.configs[i];
+		api.SetPageSegMode(
+			static_cast<tesseract::PageSegMode>(config.pageSegmentationMode));
+		api.SetVariable("tessedit_char_whitelist", config.charWhitelist.c_str());
+
+		preprocessing_params params = job.baseParams;
+		params.binarizationMode = config.binarizationMode;
+		params.binarizationThreshold = config.binarizationThreshold;
+		params.binarizationBlockSize = config.binarizationBlockSize;
+		params.dilationIterations = config.dilationIterations;
+		params.rescaleTargetSize = config.rescaleTargetSize;
+		pipeline.configure(!job.stages.empty()
+					   ? job.stages
+					   : legacy_preprocessing_stages(config.binarizationMode,
+									 config.dilationIterations,
+									 config.rescaleImage),
+				   params);
+
+		latencies.clear();
+		float accuracy_sum = 0.0f;
+		for (const tuner_sample &sample : job.samples) {
+			const auto start = std::chrono::steady_clock::now();
+			const cv::Mat &image = pipeline.process(sample.imageGray);
+			api.SetImage(image.data, image.cols, image.rows, image.channels(),
+				     (int)image.step);
+			char *text = api.GetUTF8Text();
+			std::string result = text != nullptr ? text : "";
+			delete[] text;
+			if (api.MeanTextConf() < job.confThreshold) {
+				result.clear();
+			}
+			latencies.push_back(std::chrono::duration<double, std::milli>(
+						    std::chrono::steady_clock::now() - start)
+						    .count());
+			accuracy_sum += text_accuracy(result, sample.expected);
+		}
+
+		std::nth_element(latencies.begin(), latencies.begin() + latencies.size() / 2,
+				 latencies.end());
+		tuner_result &result = job.results[i];
+		result.accuracy = accuracy_sum / (float)job.samples.size();
+		result.medianLatencyMs = latencies[latencies.size() / 2];
+		result.valid = true;
+	}
+	api.End();
+}
+
+static std::string describe_config(const tuner_config &config)
+{
+	std::ostringstream out;
+	out << "binarization=" << config.binarizationMode;
+	if (config.binarizationMode == 1) {
+		out << " threshold=" << config.binarizationThreshold;
+	} else if (config.binarizationMode == 2 || config.binarizationMode == 3) {
+		out << " block=" << config.binarizationBlockSize;
+	}
+	out << " dilation=" << config.dilationIterations << " rescale="
+	    << (config.rescaleImage ? std::to_string(config.rescaleTargetSize) : "off")
+	    << " psm=" << config.pageSegmentationMode
+	    << " whitelist=" << (config.charWhitelist.empty() ? "none" : "set");
+	return out.str();
+}
+
+static void run_auto_tuner(filter_data *tf, tuner_job job)
+{
+	const auto search_start = std::chrono::steady_clock::now();
+	job.results.resize(job.configs.size());
+
+	// leave one core to OBS, each worker owns its own tesseract instance
+	unsigned int num_workers =
+		std::max(1u, std::min(std::thread::hardware_concurrency() - 1, 8u));
+	const int max_ocr_threads = get_cpu_budget().max_ocr_threads;
+	if (max_ocr_threads > 0) {
+		num_workers = std::min(num_workers, (unsigned int)max_ocr_threads);
+	}
+	std::atomic<size_t> next_config(0);
+	std::vector<std::thread> workers;
+	for (unsigned int i = 0; i < num_workers; i++) {
+		workers.emplace_back(tuner_worker, std::ref(job), std::ref(next_config),
+				     std::cref(tf->auto_tuner_cancel));
+	}
+	for (std::thread &worker : workers) {
+		worker.join();
+	}
+	if (tf->auto_tuner_cancel) {
+		obs_log(LOG_INFO, "Auto-tuner: cancelled");
+		return;
+	}
+
+	// Pareto front: sort by latency, keep every config more accurate than all faster ones
+	std::vector<size_t> order;
+	for (size_t i = 0; i < job.results.size(); i++) {
+		if (job.results[i].valid) {
+			order.push_back(i);
+		}
+	}
+	if (order.empty()) {
+		obs_log(LOG_ERROR, "Auto-tuner: no configuration could be evaluated");
+		return;
+	}
+	std::sort(order.begin(), order.end(), [&job](size_t a, size_t b) {
+		if (job.results[a].medianLatencyMs != job.results[b].medianLatencyMs) {
+			return job.results[a].medianLatencyMs < job.results[b].medianLatencyMs;
+		}
+		return job.results[a].accuracy > job.results[b].accuracy;
+	});
+	std::vector<size_t> front;
+	for (size_t i : order) {
+		if (front.empty() || job.results[i].accuracy > job.results[front.back()].accuracy) {
+			front.push_back(i);
+		}
+	}
+
+	const double elapsed_s =
+		std::chrono::duration<double>(std::chrono::steady_clock::now() - search_start)
+			.count();
+	obs_log(LOG_INFO,
+		"Auto-tuner: evaluated %d configurations on %d samples in %.1f s, Pareto front:",
+		(int)order.size(), (int)job.samples.size(), elapsed_s);
+	for (size_t i : front) {
+		obs_log(LOG_INFO, "  %7.1f ms  %5.1f%%  %s", job.results[i].medianLatencyMs,
+			job.results[i].accuracy * 100.0f, describe_config(job.configs[i]).c_str());
+	}
+
+	std::ofstream report(job.samplesFolder + "/auto-tuner-report.csv");
+	report << "median_latency_ms,accuracy,pareto,configuration\n";
+	for (size_t i : order) {
+		const bool on_front = std::find(front.begin(), front.end(), i) != front.end();
+		report << job.results[i].medianLatencyMs << "," << job.results[i].accuracy << ","
+		       << (on_front ? 1 : 0) << ",\"" << describe_config(job.configs[i])
+		       << "\"\n";
+	}
+	report.close();
+
+	// fastest config that reaches the target, otherwise the most accurate one
+	size_t chosen = front.back();
+	for (size_t i : front) {
+		if (job.results[i].accuracy >= job.targetAccuracy) {
+			chosen = i;
+			break;
+		}
+	}
+	const tuner_config &config = job.configs[chosen];
+	obs_log(LOG_INFO, "Auto-tuner: applying %s (%.1f ms, %.1f%%)",
+		describe_config(config).c_str(), job.results[chosen].medianLatencyMs,
+		job.results[chosen].accuracy * 100.0f);
+
+	// only the options the stages read, the others keep the user's values.
+	// preprocessing_stages is left as it is, the search ran with it
+	obs_data_t *settings = obs_source_get_settings(tf->source);
+	if (stage_in_use(job.stages, PreprocessingStage::Threshold)) {
+		obs_data_set_int(settings, "binarization_mode", config.binarizationMode);
+		obs_data_set_int(settings, "binarization_threshold", config.binarizationThreshold);
+		obs_data_set_int(settings, "binarization_block_size",
+				 config.binarizationBlockSize);
+	}
+	if (stage_in_use(job.stages, PreprocessingStage::Dilate)) {
+		obs_data_set_int(settings, "dilation_iterations", config.dilationIterations);
+	}
+	if (job.stages.empty()) {
+		obs_data_set_bool(settings, "rescale_image", config.rescaleImage);
+	}
+	if (stage_in_use(job.stages, PreprocessingStage::Resize)) {
+		obs_data_set_int(settings, "rescale_target_size", config.rescaleTargetSize);
+	}
+	obs_data_set_int(settings, "page_segmentation_mode", config.pageSegmentationMode);
+	obs_data_set_string(settings, "char_whitelist", config.charWhitelist.c_str());
+	if (!job.stages.empty()) {
+		obs_log(LOG_INFO, "Auto-tuner: kept the configured preprocessing stage order, "
+				  "only the options of its stages were searched");
+	}
+	obs_source_update(tf->source, settings);
+	obs_data_release(settings);
+}
+
+void start_auto_tuner(filter_data *tf)
+{
+	if (tf->auto_tuner_running) {
+		obs_log(LOG_WARNING, "Auto-tuner: already running");
+		return;
+	}
+	stop_auto_tuner(tf);
+
+	tuner_job job;
+	obs_data_t *settings = obs_source_get_settings(tf->source);
+	job.tessdataPath = tf->tesseractTraineddataFilepath;
+	job.language = obs_data_get_string(settings, "language");
+	if (job.language == AUTO_LANGUAGE) {
+		// tune for the preferred language, the others share most of the image settings
+		const std::vector<std::string> languages =
+			parse_auto_languages(obs_data_get_string(settings, "auto_languages"));
+		job.language = languages.empty() ? "eng" : languages.front();
+	}
+	// tune the variant that will run, a fast model may need other settings than the best one
+	const std::string variantFolder =
+		find_model_folder(job.tessdataPath, obs_data_get_string(settings, "model_variant"),
+				  job.language);
+	if (!variantFolder.empty()) {
+		job.tessdataPath = variantFolder;
+	}
+	job.samplesFolder = obs_data_get_string(settings, "tuner_samples_folder");
+	job.confThreshold = (int)obs_data_get_int(settings, "conf_threshold");
+	job.targetAccuracy = (float)obs_data_get_int(settings, "tuner_target_accuracy") / 100.0f;
+	job.stages =
+		parse_preprocessing_stages(obs_data_get_string(settings, "preprocessing_stages"));
+	job.baseParams.erosionIterations = (int)obs_data_get_int(settings, "erosion_iterations");
+	job.baseParams.denoiseKernelSize = (int)obs_data_get_int(settings, "denoise_kernel_size");
+	job.configs = build_search_space(settings, job.stages);
+	obs_data_release(settings);
+
+	job.samples = load_tuner_samples(job.samplesFolder);
+	if (job.samples.empty()) {
+		obs_log(LOG_WARNING, "Auto-tuner: no samples with expected text found in '%s'",
+			job.samplesFolder.c_str());
+		return;
+	}
+	obs_log(LOG_INFO, "Auto-tuner: searching %d configurations on %d samples",
+		(int)job.configs.size(), (int)job.samples.size());
+
+	tf->auto_tuner_cancel = false;
+	tf->auto_tuner_running = true;
+	tf->auto_tuner_thread = std::thread([tf, job = std::move(job)]() mutable {
+		run_auto_tuner(tf, std::move(job));
+		tf->auto_tuner_running = false;
+	});
+}
+
+void stop_auto_tuner(filter_data *tf)
+{
+	tf->auto_tuner_cancel = true;
+	if (tf->auto_tuner_thread.joinable()) {
+		tf->auto_tuner_thread.join();
+	}
+}
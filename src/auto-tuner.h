@@ -0,0 +1,30 @@
+#ifndef AUTO_TUNER_H
+#define AUTO_TUNER_H
+
+#include "filter-data.h"
+
+#include <string>
+
+/**
+  * @brief Save the current (cropped) input frame to the tuner samples folder as a PNG, along
+  * with a .txt file holding the current output as a starting point for the expected text.
+  * @return true if the sample was saved
+*/
+bool capture_tuner_sample(filter_data *tf);
+
+/**
+  * @brief Start searching the preprocessing and segmentation settings on a background thread.
+  *
+  * Every captured sample with a matching .txt file is recognized with each candidate setting.
+  * The Pareto front of median latency against accuracy is logged and written to
+  * auto-tuner-report.csv in the samples folder, and the fastest setting that reaches the target
+  * accuracy (or the most accurate one) is written back into the filter's settings.
+*/
+void start_auto_tuner(filter_data *tf);
+
+/**
+  * @brief Cancel a running search and join its thread
+*/
+void stop_auto_tuner(filter_data *tf);
+
+#endif /* AUTO_TUNER_H */
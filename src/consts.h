@@ -37,8 +37,28 @@ const char *const WHITELIST_CHARS_ARABIC =
 // numeric characters with punctuation for time, date, currency, etc.
 const char *const WHITELIST_CHARS_NUMERIC = "0123456789!@#$%^&*()_+-=[]{}|;':\",./<>?`~\\ ";
 
+// confusion tables for the post-processing replacements
+const char *const CONFUSIONS_TO_DIGITS = "O=0,o=0,D=0,Q=0,I=1,l=1,|=1,Z=2,z=2,S=5,s=5,B=8";
+const char *const CONFUSIONS_TO_LETTERS = "0=O,1=I,2=Z,5=S,8=B";
+
 const int OUTPUT_IMAGE_OPTION_DETECTION_MASK = 0;
 const int OUTPUT_IMAGE_OPTION_TEXT_OVERLAY = 1;
 const int OUTPUT_IMAGE_OPTION_TEXT_BACKGROUND = 2;
 
+const int OCR_ENGINE_TESSERACT = 0;
+const int OCR_ENGINE_SEVEN_SEGMENT = 1;
+const int OCR_ENGINE_CRNN = 2;
+
+// language value that picks the model from the script on screen
+const char *const AUTO_LANGUAGE = "auto";
+
+// Tesseract model variants, see model-manager.h
+const char *const MODEL_VARIANT_BEST = "best";
+const char *const MODEL_VARIANT_FAST = "fast";
+const char *const MODEL_VARIANT_INT = "int";
+
+const int OCR_PRIORITY_NORMAL = 0;
+const int OCR_PRIORITY_BELOW_NORMAL = 1;
+const int OCR_PRIORITY_LOWEST = 2;
+
 #endif /* CONSTS_H */
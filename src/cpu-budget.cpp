@@ -0,0 +1,285 @@
+#include "cpu-budget.h"
+#include "consts.h"
+#include "obs-utils.h"
+#include "plugin-support.h"
+
+#include <obs-module.h>
+
+#include <opencv2/core/utility.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#endif
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+std::mutex budget_mutex;
+std::condition_variable slots_cv;
+cpu_budget budget;
+std::atomic<uint64_t> budget_version{1};
+int active_slots = 0;
+
+const char *const CPU_BUDGET_FILE = "cpu-budget.json";
+
+/**
+  * @brief Parse a core list like "0-3,6" into core indices, invalid parts are skipped
+*/
+std::vector<int> parse_core_list(const std::string &spec)
+{
+	std::vector<int> cores;
+	std::stringstream ss(spec);
+	std::string part;
+	while (std::getline(ss, part, ',')) {
+		int first = 0;
+		int last = 0;
+		if (sscanf(part.c_str(), "%d-%d", &first, &last) != 2) {
+			if (sscanf(part.c_str(), "%d", &first) != 1) {
+				continue;
+			}
+			last = first;
+		}
+		for (int core = std::max(first, 0); core <= last && core < 1024; core++) {
+			cores.push_back(core);
+		}
+	}
+	return cores;
+}
+
+/**
+  * @brief omp_set_num_threads of the OpenMP runtime Tesseract was built with, looked up at
+  * runtime so that the plugin itself doesn't need OpenMP. nullptr without OpenMP.
+*/
+using omp_set_num_threads_t = void (*)(int);
+omp_set_num_threads_t find_omp_set_num_threads()
+{
+#ifdef _WIN32
+	for (const char *runtime : {"vcomp140.dll", "libgomp-1.dll", "libomp.dll"}) {
+		HMODULE module = GetModuleHandleA(runtime);
+		if (module != nullptr) {
+			return reinterpret_cast<omp_set_num_threads_t>(
+				GetProcAddress(module, "omp_set_num_threads"));
+		}
+	}
+	return nullptr;
+#else
+	return reinterpret_cast<omp_set_num_threads_t>(dlsym(RTLD_DEFAULT, "omp_set_num_threads"));
+#endif
+}
+
+void set_current_thread_affinity(const std::vector<int> &cores)
+{
+#if defined(_WIN32)
+	DWORD_PTR mask = 0;
+	for (int core : cores) {
+		if (core < (int)(sizeof(DWORD_PTR) * 8)) {
+			mask |= (DWORD_PTR)1 << core;
+		}
+	}
+	if (mask == 0) {
+		// all cores of the process
+		DWORD_PTR system_mask = 0;
+		GetProcessAffinityMask(GetCurrentProcess(), &mask, &system_mask);
+	}
+	if (SetThreadAffinityMask(GetCurrentThread(), mask) == 0) {
+		obs_log(LOG_WARNING, "Failed to set the OCR thread affinity");
+	}
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (int core : cores) {
+		if (core < CPU_SETSIZE) {
+			CPU_SET(core, &set);
+		}
+	}
+	if (CPU_COUNT(&set) == 0) {
+		// all cores of the process
+		sched_getaffinity(0, sizeof(set), &set);
+	}
+	if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+		obs_log(LOG_WARNING, "Failed to set the OCR thread affinity");
+	}
+#else
+	if (!cores.empty()) {
+		obs_log(LOG_WARNING, "OCR thread affinity is not supported on this platform");
+	}
+#endif
+}
+
+void set_current_thread_priority(int priority)
+{
+#if defined(_WIN32)
+	int thread_priority = THREAD_PRIORITY_NORMAL;
+	if (priority == OCR_PRIORITY_BELOW_NORMAL) {
+		thread_priority = THREAD_PRIORITY_BELOW_NORMAL;
+	} else if (priority == OCR_PRIORITY_LOWEST) {
+		thread_priority = THREAD_PRIORITY_LOWEST;
+	}
+	SetThreadPriority(GetCurrentThread(), thread_priority);
+#elif defined(__APPLE__)
+	qos_class_t qos = QOS_CLASS_DEFAULT;
+	if (priority == OCR_PRIORITY_BELOW_NORMAL) {
+		qos = QOS_CLASS_UTILITY;
+	} else if (priority == OCR_PRIORITY_LOWEST) {
+		qos = QOS_CLASS_BACKGROUND;
+	}
+	pthread_set_qos_class_self_np(qos, 0);
+#elif defined(__linux__)
+	// on Linux the nice value is per thread, relative to the one OBS runs at
+	int nice_value = getpriority(PRIO_PROCESS, 0);
+	if (priority == OCR_PRIORITY_BELOW_NORMAL) {
+		nice_value = std::min(nice_value + 5, 19);
+	} else if (priority == OCR_PRIORITY_LOWEST) {
+		nice_value = 19;
+	}
+	if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), nice_value) != 0) {
+		// raising the priority back needs CAP_SYS_NICE or a matching RLIMIT_NICE
+		obs_log(LOG_WARNING, "Failed to set the OCR thread nice value to %d", nice_value);
+	}
+#else
+	UNUSED_PARAMETER(priority);
+#endif
+}
+
+void apply_process_budget(const cpu_budget &applied)
+{
+	// OpenCV takes a negative count for its default, 0 would make it single-threaded
+	cv::setNumThreads(applied.opencv_threads > 0 ? applied.opencv_threads : -1);
+}
+
+} // namespace
+
+cpu_budget get_cpu_budget()
+{
+	std::lock_guard<std::mutex> lock(budget_mutex);
+	return budget;
+}
+
+void set_cpu_budget(const cpu_budget &next)
+{
+	{
+		std::lock_guard<std::mutex> lock(budget_mutex);
+		budget = next;
+		budget_version++;
+	}
+	// a higher cap may free waiting workers
+	slots_cv.notify_all();
+	apply_process_budget(next);
+
+	obs_data_t *data = obs_data_create();
+	obs_data_set_int(data, "max_ocr_threads", next.max_ocr_threads);
+	obs_data_set_int(data, "omp_threads", next.omp_threads);
+	obs_data_set_int(data, "opencv_threads", next.opencv_threads);
+	obs_data_set_string(data, "affinity", next.affinity.c_str());
+	obs_data_set_int(data, "priority", next.priority);
+	check_plugin_config_folder_exists();
+	char *path = obs_module_config_path(CPU_BUDGET_FILE);
+	if (!obs_data_save_json_safe(data, path, "tmp", "bak")) {
+		obs_log(LOG_WARNING, "Failed to save the CPU budget to %s", path);
+	}
+	bfree(path);
+	obs_data_release(data);
+
+	obs_log(LOG_INFO,
+		"CPU budget: max OCR threads %d, OpenMP threads %d, OpenCV threads %d, "
+		"affinity '%s', priority %d",
+		next.max_ocr_threads, next.omp_threads, next.opencv_threads,
+		next.affinity.c_str(), next.priority);
+}
+
+void load_cpu_budget(void)
+{
+	char *path = obs_module_config_path(CPU_BUDGET_FILE);
+	obs_data_t *data = obs_data_create_from_json_file_safe(path, "bak");
+	bfree(path);
+	if (data == nullptr) {
+		return;
+	}
+	cpu_budget loaded;
+	loaded.max_ocr_threads = (int)obs_data_get_int(data, "max_ocr_threads");
+	loaded.omp_threads = (int)obs_data_get_int(data, "omp_threads");
+	loaded.opencv_threads = (int)obs_data_get_int(data, "opencv_threads");
+	loaded.affinity = obs_data_get_string(data, "affinity");
+	loaded.priority = (int)obs_data_get_int(data, "priority");
+	obs_data_release(data);
+
+	{
+		std::lock_guard<std::mutex> lock(budget_mutex);
+		budget = loaded;
+		budget_version++;
+	}
+	apply_process_budget(loaded);
+}
+
+void apply_cpu_budget_to_current_thread(uint64_t &applied_version)
+{
+	const uint64_t version = budget_version;
+	if (version == applied_version) {
+		return;
+	}
+	const cpu_budget current = get_cpu_budget();
+	applied_version = version;
+
+	// threads are left alone until a budget asks for something, and reset when it stops
+	thread_local std::string applied_affinity;
+	thread_local int applied_priority = OCR_PRIORITY_NORMAL;
+	thread_local int applied_omp_threads = 0;
+	if (current.affinity != applied_affinity) {
+		set_current_thread_affinity(parse_core_list(current.affinity));
+		applied_affinity = current.affinity;
+	}
+	if (current.priority != applied_priority) {
+		set_current_thread_priority(current.priority);
+		applied_priority = current.priority;
+	}
+
+	// the OpenMP thread count is per calling thread, Tesseract's parallel regions started from
+	// this thread use it. Its worker threads inherit the affinity and priority set above.
+	static const omp_set_num_threads_t omp_set_num_threads = find_omp_set_num_threads();
+	if (omp_set_num_threads != nullptr && current.omp_threads != applied_omp_threads) {
+		// the runtime default is one thread per core
+		const int cores = (int)std::max(1u, std::thread::hardware_concurrency());
+		omp_set_num_threads(current.omp_threads > 0 ? current.omp_threads : cores);
+		applied_omp_threads = current.omp_threads;
+	}
+}
+
+OcrSlot::OcrSlot(std::chrono::milliseconds timeout)
+{
+	std::unique_lock<std::mutex> lock(budget_mutex);
+	isAcquired = slots_cv.wait_for(lock, timeout, [] {
+		return budget.max_ocr_threads <= 0 || active_slots < budget.max_ocr_threads;
+	});
+	if (isAcquired) {
+		active_slots++;
+	}
+}
+
+OcrSlot::~OcrSlot()
+{
+	if (!isAcquired) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(budget_mutex);
+		active_slots--;
+	}
+	slots_cv.notify_one();
+}
@@ -0,0 +1,71 @@
+#ifndef CPU_BUDGET_H
+#define CPU_BUDGET_H
+
+#ifdef __cplusplus
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+  * @brief Plugin-wide limits on the CPU used for OCR, shared by all filter instances.
+  *
+  * Stored in cpu-budget.json in the module config folder. Zero means "no limit" or "runtime
+  * default" everywhere.
+*/
+struct cpu_budget {
+	// recognitions running at the same time across all filters
+	int max_ocr_threads = 0;
+	// OpenMP threads per Tesseract call
+	int omp_threads = 0;
+	// OpenCV parallel_for threads, process-wide
+	int opencv_threads = 0;
+	// cores the OCR threads may run on, e.g. "2-3,6"
+	std::string affinity;
+	int priority = 0;
+};
+
+cpu_budget get_cpu_budget();
+
+/**
+  * @brief Replace the budget, save it and apply the process-wide parts. Threads pick up the
+  * rest at their next apply_cpu_budget_to_current_thread call.
+*/
+void set_cpu_budget(const cpu_budget &budget);
+
+/**
+  * @brief Apply the affinity, priority and OpenMP thread count to the calling thread if the
+  * budget changed since the last call
+  * @param applied_version Version last applied to this thread, 0 initially
+*/
+void apply_cpu_budget_to_current_thread(uint64_t &applied_version);
+
+/**
+  * @brief A slot out of max_ocr_threads, held for the duration of one recognition
+*/
+class OcrSlot {
+public:
+	/**
+	  * @brief Wait up to timeout for a free slot
+	*/
+	explicit OcrSlot(std::chrono::milliseconds timeout);
+	~OcrSlot();
+	OcrSlot(const OcrSlot &) = delete;
+	OcrSlot &operator=(const OcrSlot &) = delete;
+
+	bool acquired() const { return isAcquired; }
+
+private:
+	bool isAcquired = false;
+};
+
+extern "C" {
+#endif
+
+void load_cpu_budget(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CPU_BUDGET_H */
@@ -0,0 +1,203 @@
+#include "ocr-engine.h"
+#include "filter-data.h"
+#include "plugin-support.h"
+
+#include <obs-module.h>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/dnn.hpp>
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// input size of the CRNN text recognition models of the OpenCV model zoo
+const cv::Size CRNN_INPUT_SIZE(100, 32);
+
+/**
+  * @brief CRNN text recognition with OpenCV DNN. The network reads a single line of text, so
+  * without the detection prepass the whole image is recognized as one line.
+*/
+class CrnnEngine : public OcrEngine {
+public:
+	CrnnEngine(const cv::dnn::TextRecognitionModel &model_,
+		   std::vector<std::string> vocabulary_)
+		: model(model_),
+		  vocabulary(std::move(vocabulary_))
+	{
+	}
+
+	const char *name() const override { return "CRNN"; }
+
+	void configure(const ocr_settings &) override {}
+
+	bool recognize(const ocr_request &request, const ocr_settings &settings,
+		       ocr_engine_result &result) override
+	{
+		const cv::Rect bounds(0, 0, request.image.cols, request.image.rows);
+		std::vector<cv::Rect> whole_image;
+		if (request.lines == nullptr) {
+			whole_image.push_back(bounds);
+		}
+		const std::vector<cv::Rect> &lines =
+			request.lines != nullptr ? *request.lines : whole_image;
+
+		int confidence_sum = 0;
+		int recognized = 0;
+		for (const cv::Rect &line : lines) {
+			const cv::Rect roi = line & bounds;
+			if (roi.area() <= 0) {
+				continue;
+			}
+			std::string lineText;
+			int confidence = 0;
+			if (!recognize_line(request.image(roi), lineText, confidence)) {
+				return false;
+			}
+			if (lineText.empty() || confidence < settings.conf_threshold) {
+				continue;
+			}
+			if (!result.text.empty()) {
+				result.text += "\n";
+			}
+			result.text += lineText;
+			confidence_sum += confidence;
+			recognized++;
+			result.boxes.push_back(OCRBox{lineText, roi});
+		}
+		if (recognized > 0) {
+			result.confidence = confidence_sum / recognized;
+		}
+		return true;
+	}
+
+	void warm_up() override
+	{
+		// the zoo has both color and grayscale models, find out which one this is
+		cv::Mat image(CRNN_INPUT_SIZE, CV_8UC3, cv::Scalar(255, 255, 255));
+		cv::putText(image, "0123", cv::Point(4, 24), cv::FONT_HERSHEY_SIMPLEX, 0.8,
+			    cv::Scalar(0, 0, 0), 2);
+		std::string text;
+		int confidence = 0;
+		if (!recognize_line(image, text, confidence)) {
+			grayInput = !grayInput;
+			if (recognize_line(image, text, confidence)) {
+				obs_log(LOG_INFO, "CRNN model takes %s input",
+					grayInput ? "grayscale" : "color");
+			}
+		}
+	}
+
+private:
+	bool recognize_line(const cv::Mat &image, std::string &text, int &confidence)
+	{
+		const int channels = grayInput ? 1 : 3;
+		if (image.channels() == channels) {
+			input = image;
+		} else if (channels == 1) {
+			cv::cvtColor(image, input,
+				     image.channels() == 4 ? cv::COLOR_BGRA2GRAY
+							   : cv::COLOR_BGR2GRAY);
+		} else {
+			cv::cvtColor(image, input,
+				     image.channels() == 4 ? cv::COLOR_BGRA2BGR
+							   : cv::COLOR_GRAY2BGR);
+		}
+
+		try {
+			model.predict(input, outputs);
+		} catch (const cv::Exception &e) {
+			obs_log(LOG_DEBUG, "CRNN inference failed: %s", e.what());
+			return false;
+		}
+		if (outputs.empty()) {
+			return false;
+		}
+
+		// CTC greedy decoding of the [time steps, 1, blank + vocabulary] scores, the
+		// confidence is the mean probability of the emitted characters
+		const int classes = (int)vocabulary.size() + 1;
+		const int steps = (int)(outputs[0].total() / (size_t)classes);
+		const cv::Mat scores = outputs[0].reshape(1, steps);
+		text.clear();
+		double probability_sum = 0.0;
+		int emitted = 0;
+		int previous = 0;
+		for (int t = 0; t < steps; t++) {
+			const float *row = scores.ptr<float>(t);
+			int best = 0;
+			for (int c = 1; c < classes; c++) {
+				if (row[c] > row[best]) {
+					best = c;
+				}
+			}
+			if (best != 0 && best != previous) {
+				double sum = 0.0;
+				for (int c = 0; c < classes; c++) {
+					sum += std::exp((double)(row[c] - row[best]));
+				}
+				probability_sum += 1.0 / sum;
+				emitted++;
+				text += vocabulary[(size_t)best - 1];
+			}
+			previous = best;
+		}
+		confidence = emitted > 0 ? (int)(100.0 * probability_sum / emitted) : 0;
+		return true;
+	}
+
+	cv::dnn::TextRecognitionModel model;
+	std::vector<std::string> vocabulary;
+	bool grayInput = false;
+	cv::Mat input;
+	std::vector<cv::Mat> outputs;
+};
+
+} // namespace
+
+std::unique_ptr<OcrEngine> create_crnn_engine(filter_data *tf, const ocr_settings &settings)
+{
+	// <model>.onnx with its vocabulary, one symbol per line, in <model>.txt
+	const std::string stem = std::string(tf->tesseractTraineddataFilepath) + "/" +
+				 settings.crnn_model;
+	const std::string model_path = stem + ".onnx";
+	const std::string vocabulary_path = stem + ".txt";
+	if (settings.crnn_model.empty() || !std::filesystem::exists(model_path)) {
+		obs_log(LOG_ERROR, "CRNN model not found: %s", model_path.c_str());
+		return nullptr;
+	}
+
+	std::vector<std::string> vocabulary;
+	std::ifstream vocabulary_file(vocabulary_path);
+	std::string symbol;
+	while (std::getline(vocabulary_file, symbol)) {
+		if (!symbol.empty() && symbol.back() == '\r') {
+			symbol.pop_back();
+		}
+		vocabulary.push_back(symbol);
+	}
+	if (vocabulary.empty()) {
+		obs_log(LOG_ERROR, "CRNN vocabulary not found or empty: %s",
+			vocabulary_path.c_str());
+		return nullptr;
+	}
+
+	obs_log(LOG_INFO, "Loading CRNN model from: %s", model_path.c_str());
+	try {
+		cv::dnn::TextRecognitionModel model(model_path);
+		model.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+		model.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+		model.setInputParams(1.0 / 127.5, CRNN_INPUT_SIZE, cv::Scalar(127.5, 127.5, 127.5));
+		model.setDecodeType("CTC-greedy");
+		model.setVocabulary(vocabulary);
+		return std::make_unique<CrnnEngine>(model, std::move(vocabulary));
+	} catch (const cv::Exception &e) {
+		obs_log(LOG_ERROR, "Failed to load CRNN model: %s", e.what());
+		return nullptr;
+	}
+}
@@ -5,16 +5,34 @@
 
 #include <opencv2/core/mat.hpp>
 
-#include <tesseract/baseapi.h>
+#include "ocr-settings.h"
+#include "ocr-engine.h"
 
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
 #include <condition_variable>
-#include <string>
+#include <vector>
 
 class CharacterBasedSmoothingFilter;
 
+/**
+  * @brief A recognition result as published to the ocr_result signal and the proc handlers
+*/
+struct ocr_result_event {
+	// stripped and smoothed, not formatted with the output template
+	std::string text;
+	int confidence = 0;
+	// word/line boxes in source pixels
+	std::vector<OCRBox> boxes;
+	// OBS video timestamp of the frame
+	uint64_t frame_timestamp_ns = 0;
+	// increases with every published result
+	uint64_t sequence = 0;
+};
+
 /**
   * @brief The filter_data struct
   *
@@ -24,60 +42,80 @@ struct filter_data {
 
 	obs_source_t *source;
 	std::string unique_id;
+	// labels this filter's events in the pipeline trace
+	uint32_t trace_id = 0;
 	gs_texrender_t *texrender;
 	gs_stagesurf_t *stagesurface;
 	gs_effect_t *effect;
 
-	cv::Mat inputBGRA;
-	cv::Mat lastInputBGRA;
+	// luminance of the crop region of the latest frame the worker asked for, converted once on
+	// capture, everything after works on it
+	cv::Mat inputGray;
+	// top-left corner of inputGray in the source frame, guarded by inputGrayLock
+	cv::Point inputCropOffset;
+	// set by the worker when it is about to process a frame, the render thread only reads back
+	// and converts the frames that were asked for
+	std::atomic<bool> frameRequested{false};
+	// counts the frames written to inputGray
+	std::atomic<uint64_t> inputFrameSequence{0};
+	// set by the trigger_ocr proc, recognizes the next frame even if it didn't change
+	std::atomic<bool> ocr_triggered{false};
+	// OBS video timestamp of the frame in inputGray, guarded by inputGrayLock
+	uint64_t inputTimestampNs = 0;
+	cv::Mat lastInputGray;
 	cv::Mat outputPreviewBGRA;
-	cv::Rect2i cropRegionRelative;
 	gs_texture_t *outputPreviewTexture = nullptr;
-	tesseract::TessBaseAPI *tesseract_model;
-	std::string language;
-	int pageSegmentationMode;
-	int binarizationMode;
-	int binarizationThreshold;
-	int binarizationBlockSize;
-	bool previewBinarization;
-	int dilationIterations;
-	bool rescaleImage;
-	int rescaleTargetSize;
-	std::string char_whitelist;
-	std::string user_patterns;
-	int conf_threshold;
-	bool enable_smoothing;
 	std::unique_ptr<CharacterBasedSmoothingFilter> smoothing_filter;
-	size_t word_length;
-	size_t window_size;
-	uint32_t update_timer_ms;
-	std::string output_format_template;
-	bool update_on_change;
-	int update_on_change_threshold;
-	int output_image_option;
-	bool output_file_append;
-	bool output_flatten;
-
-	bool isDisabled;
-
-	std::mutex inputBGRALock;
+
+	// latest settings snapshot, only accessed through std::atomic_load/std::atomic_store
+	std::shared_ptr<const ocr_settings> settings;
+	// only written by ocr_filter_update
+	uint64_t settings_version = 0;
+
+	// the worker parks while the filter is disabled, or its source is neither active nor shown
+	std::atomic<bool> isDisabled{false};
+	std::atomic<bool> isActive{true};
+	std::atomic<bool> isShowing{true};
+
+	std::mutex inputGrayLock;
 	std::mutex outputPreviewBGRALock;
 	std::mutex tesseract_mutex;
-	std::mutex tesseract_settings_mutex;
 	bool tesseract_thread_run;
 	std::condition_variable tesseract_thread_cv;
 	std::thread tesseract_thread;
 
-	// Text source to output the text to
+	// Auto-tuner search running in the background
+	std::thread auto_tuner_thread;
+	std::atomic<bool> auto_tuner_running{false};
+	std::atomic<bool> auto_tuner_cancel{false};
+
+	// Text source to output the text to, the names are the UI side copies used to detect a
+	// change of source, the worker reads them from the settings snapshot
 	obs_weak_source_t *output_source = nullptr;
 	char *output_source_name = nullptr;
 	// Image source to output the detection mask to
 	obs_weak_source_t *output_image_source = nullptr;
 	char *output_image_source_name = nullptr;
 	std::mutex *output_source_mutex = nullptr;
-	std::string output_file_path;
+
+	// latest published result, for the get_last_ocr_result proc
+	std::mutex last_result_mutex;
+	ocr_result_event last_result;
 
 	char *tesseractTraineddataFilepath = nullptr;
 };
 
+inline bool is_filter_idle(const filter_data *tf)
+{
+	return tf->isDisabled || (!tf->isActive && !tf->isShowing);
+}
+
+/**
+  * @brief Get the latest settings snapshot, safe to call from any thread
+*/
+inline std::shared_ptr<const ocr_settings> get_ocr_settings(const filter_data *tf)
+{
+	return std::atomic_load(&tf->settings);
+}
+
 #endif /* FILTERDATA_H */
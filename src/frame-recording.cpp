@@ -0,0 +1,381 @@
+#include "frame-recording.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+void frame_rle_encode(const uint8_t *data, size_t size, std::vector<uint8_t> &out)
+{
+	out.clear();
+	size_t i = 0;
+	while (i < size) {
+		size_t run = 1;
+		while (i + run < size && run < 65535 && data[i + run] == data[i]) {
+			run++;
+		}
+		if (run > 129) {
+			// the frame differences are mostly long runs of zeros
+			out.push_back(255);
+			out.push_back((uint8_t)(run & 0xff));
+			out.push_back((uint8_t)(run >> 8));
+			out.push_back(data[i]);
+			i += run;
+			continue;
+		}
+		if (run >= 3) {
+			out.push_back((uint8_t)(run + 125));
+			out.push_back(data[i]);
+			i += run;
+			continue;
+		}
+		// literals up to the next run of three
+		const size_t start = i;
+		size_t length = 0;
+		while (i < size && length < 128) {
+			if (i + 2 < size && data[i] == data[i + 1] && data[i] == data[i + 2]) {
+				break;
+			}
+			i++;
+			length++;
+		}
+		out.push_back((uint8_t)(length - 1));
+		out.insert(out.end(), data + start, data + start + length);
+	}
+}
+
+bool frame_rle_decode(const uint8_t *data, size_t size, uint8_t *out, size_t outSize)
+{
+	size_t in = 0;
+	size_t written = 0;
+	while (in < size) {
+		const uint8_t token = data[in++];
+		if (token < 128) {
+			const size_t length = (size_t)token + 1;
+			if (in + length > size || written + length > outSize) {
+				return false;
+			}
+			memcpy(out + written, data + in, length);
+			in += length;
+			written += length;
+		} else {
+			size_t length = (size_t)token - 125;
+			if (token == 255) {
+				if (in + 2 > size) {
+					return false;
+				}
+				length = (size_t)data[in] | (size_t)data[in + 1] << 8;
+				in += 2;
+			}
+			if (in >= size || written + length > outSize) {
+				return false;
+			}
+			memset(out + written, data[in++], length);
+			written += length;
+		}
+	}
+	return written == outSize;
+}
+
+FrameRecordingWriter::~FrameRecordingWriter()
+{
+	close();
+}
+
+bool FrameRecordingWriter::open(const std::string &path, uint32_t keyframeInterval_)
+{
+	close();
+	file.open(path, std::ios_base::binary | std::ios_base::trunc);
+	if (!file.is_open()) {
+		return false;
+	}
+	keyframeInterval = std::max<uint32_t>(1, keyframeInterval_);
+	const frame_recording_header header = {FRAME_RECORDING_MAGIC, FRAME_RECORDING_VERSION,
+					       keyframeInterval, 0};
+	file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	offset = sizeof(header);
+	framesSinceKeyframe = 0;
+	keyframeOffset = 0;
+	settingsOffset = 0;
+	previous.release();
+	index.clear();
+	return true;
+}
+
+void FrameRecordingWriter::close()
+{
+	if (!file.is_open()) {
+		return;
+	}
+	const frame_index_footer footer = {FRAME_INDEX_MAGIC, 0, offset, index.size()};
+	file.write(reinterpret_cast<const char *>(index.data()),
+		   (std::streamsize)(index.size() * sizeof(frame_index_entry)));
+	file.write(reinterpret_cast<const char *>(&footer), sizeof(footer));
+	file.close();
+	index.clear();
+	previous.release();
+}
+
+void FrameRecordingWriter::write_record(uint32_t type, uint64_t timestampNs, uint32_t width,
+					uint32_t height, const uint8_t *payload,
+					size_t payloadSize)
+{
+	const frame_record_header header = {FRAME_RECORD_MAGIC, type,   timestampNs,
+					    width,              height, (uint32_t)payloadSize,
+					    0};
+	file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char *>(payload), (std::streamsize)payloadSize);
+	offset += sizeof(header) + payloadSize;
+}
+
+void FrameRecordingWriter::write_settings(const std::string &json, uint64_t timestampNs)
+{
+	if (!file.is_open()) {
+		return;
+	}
+	settingsOffset = offset;
+	write_record(FRAME_RECORD_SETTINGS, timestampNs, 0, 0,
+		     reinterpret_cast<const uint8_t *>(json.data()), json.size());
+}
+
+void FrameRecordingWriter::write_frame(const cv::Mat &gray, uint64_t timestampNs)
+{
+	if (!file.is_open() || gray.empty() || gray.type() != CV_8UC1) {
+		return;
+	}
+	const cv::Mat frame = gray.isContinuous() ? gray : gray.clone();
+	const size_t pixels = frame.total();
+	const bool keyframe = previous.size() != frame.size() ||
+			      framesSinceKeyframe + 1 >= keyframeInterval;
+	const uint64_t recordOffset = offset;
+	if (keyframe) {
+		frame_rle_encode(frame.data, pixels, encoded);
+		keyframeOffset = recordOffset;
+		framesSinceKeyframe = 0;
+	} else {
+		// wraps around, the reader adds it back the same way
+		difference.resize(pixels);
+		for (size_t i = 0; i < pixels; i++) {
+			difference[i] = (uint8_t)(frame.data[i] - previous.data[i]);
+		}
+		frame_rle_encode(difference.data(), pixels, encoded);
+		framesSinceKeyframe++;
+	}
+	write_record(keyframe ? FRAME_RECORD_KEYFRAME : FRAME_RECORD_DELTA, timestampNs,
+		     (uint32_t)frame.cols, (uint32_t)frame.rows, encoded.data(), encoded.size());
+	index.push_back({recordOffset, timestampNs, keyframeOffset, settingsOffset});
+	frame.copyTo(previous);
+	// complete records survive a crash, the index is rebuilt from them
+	file.flush();
+}
+
+FrameRecordingReader::~FrameRecordingReader()
+{
+	close();
+}
+
+bool FrameRecordingReader::open(const std::string &path)
+{
+	close();
+	const void *memory = nullptr;
+#ifdef _WIN32
+	fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+				 OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	LARGE_INTEGER fileSize;
+	if (fileHandle == INVALID_HANDLE_VALUE || !GetFileSizeEx(fileHandle, &fileSize) ||
+	    fileSize.QuadPart < (LONGLONG)sizeof(frame_recording_header)) {
+		close();
+		return false;
+	}
+	size = (size_t)fileSize.QuadPart;
+	mapping = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping != nullptr) {
+		memory = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	}
+#else
+	fd = ::open(path.c_str(), O_RDONLY);
+	struct stat info;
+	if (fd < 0 || fstat(fd, &info) != 0 ||
+	    (size_t)info.st_size < sizeof(frame_recording_header)) {
+		close();
+		return false;
+	}
+	size = (size_t)info.st_size;
+	memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (memory == MAP_FAILED) {
+		memory = nullptr;
+	}
+#endif
+	if (memory == nullptr) {
+		close();
+		return false;
+	}
+
+	data = static_cast<const uint8_t *>(memory);
+	const frame_recording_header *header =
+		reinterpret_cast<const frame_recording_header *>(data);
+	if (header->magic != FRAME_RECORDING_MAGIC || header->version != FRAME_RECORDING_VERSION) {
+		close();
+		return false;
+	}
+	build_index();
+	return true;
+}
+
+void FrameRecordingReader::close()
+{
+#ifdef _WIN32
+	if (data != nullptr) {
+		UnmapViewOfFile(data);
+	}
+	if (mapping != nullptr) {
+		CloseHandle(mapping);
+		mapping = nullptr;
+	}
+	if (fileHandle != nullptr && fileHandle != INVALID_HANDLE_VALUE) {
+		CloseHandle(fileHandle);
+	}
+	fileHandle = nullptr;
+#else
+	if (data != nullptr) {
+		munmap(const_cast<uint8_t *>(data), size);
+	}
+	if (fd >= 0) {
+		::close(fd);
+		fd = -1;
+	}
+#endif
+	data = nullptr;
+	size = 0;
+	index.clear();
+	current.release();
+	currentFrame = SIZE_MAX;
+}
+
+bool FrameRecordingReader::record_at(uint64_t offset, frame_record_header &record) const
+{
+	if (offset < sizeof(frame_recording_header) ||
+	    offset + sizeof(frame_record_header) > size) {
+		return false;
+	}
+	memcpy(&record, data + offset, sizeof(record));
+	return record.magic == FRAME_RECORD_MAGIC &&
+	       offset + sizeof(frame_record_header) + record.payload_size <= size;
+}
+
+void FrameRecordingReader::build_index()
+{
+	index.clear();
+	if (size >= sizeof(frame_recording_header) + sizeof(frame_index_footer)) {
+		frame_index_footer footer;
+		memcpy(&footer, data + size - sizeof(footer), sizeof(footer));
+		const uint64_t indexEnd = size - sizeof(footer);
+		if (footer.magic == FRAME_INDEX_MAGIC &&
+		    footer.frame_count <= indexEnd / sizeof(frame_index_entry) &&
+		    footer.index_offset + footer.frame_count * sizeof(frame_index_entry) ==
+			    indexEnd) {
+			index.resize((size_t)footer.frame_count);
+			memcpy(index.data(), data + footer.index_offset,
+			       index.size() * sizeof(frame_index_entry));
+			return;
+		}
+	}
+
+	// not closed, walk the records up to the first incomplete one
+	uint64_t offset = sizeof(frame_recording_header);
+	uint64_t keyframeOffset = 0;
+	uint64_t settingsOffset = 0;
+	frame_record_header record;
+	while (record_at(offset, record)) {
+		if (record.type == FRAME_RECORD_SETTINGS) {
+			settingsOffset = offset;
+		} else {
+			if (record.type == FRAME_RECORD_KEYFRAME) {
+				keyframeOffset = offset;
+			}
+			if (keyframeOffset != 0) {
+				index.push_back({offset, record.timestamp_ns, keyframeOffset,
+						 settingsOffset});
+			}
+		}
+		offset += sizeof(frame_record_header) + record.payload_size;
+	}
+}
+
+bool FrameRecordingReader::apply_record(uint64_t offset)
+{
+	frame_record_header record;
+	if (!record_at(offset, record) || record.width == 0 || record.height == 0 ||
+	    record.width > 1 << 15 || record.height > 1 << 15) {
+		return false;
+	}
+	const uint8_t *payload = data + offset + sizeof(record);
+	const cv::Size frameSize((int)record.width, (int)record.height);
+	if (record.type == FRAME_RECORD_KEYFRAME) {
+		current.create(frameSize, CV_8UC1);
+		return frame_rle_decode(payload, record.payload_size, current.data,
+					current.total());
+	}
+	if (record.type != FRAME_RECORD_DELTA || current.size() != frameSize) {
+		return false;
+	}
+	difference.resize(current.total());
+	if (!frame_rle_decode(payload, record.payload_size, difference.data(),
+			      difference.size())) {
+		return false;
+	}
+	for (size_t i = 0; i < difference.size(); i++) {
+		current.data[i] = (uint8_t)(current.data[i] + difference[i]);
+	}
+	return true;
+}
+
+bool FrameRecordingReader::read_frame(size_t frame, cv::Mat &gray)
+{
+	if (frame >= index.size()) {
+		return false;
+	}
+	// continue from the last decoded frame when it is in the same group, else from the keyframe
+	size_t first = frame;
+	if (currentFrame != SIZE_MAX && currentFrame < frame &&
+	    index[currentFrame].keyframe_offset == index[frame].keyframe_offset) {
+		first = currentFrame + 1;
+	} else {
+		while (first > 0 && index[first].offset != index[frame].keyframe_offset) {
+			first--;
+		}
+		if (index[first].offset != index[frame].keyframe_offset) {
+			return false;
+		}
+	}
+	for (size_t i = first; i <= frame; i++) {
+		if (!apply_record(index[i].offset)) {
+			currentFrame = SIZE_MAX;
+			return false;
+		}
+		currentFrame = i;
+	}
+	current.copyTo(gray);
+	return true;
+}
+
+std::string FrameRecordingReader::settings_json(size_t frame) const
+{
+	if (frame >= index.size()) {
+		return "";
+	}
+	const uint64_t offset = index[frame].settings_offset;
+	frame_record_header record;
+	if (!record_at(offset, record) || record.type != FRAME_RECORD_SETTINGS) {
+		return "";
+	}
+	return std::string(reinterpret_cast<const char *>(data + offset + sizeof(record)),
+			   record.payload_size);
+}
@@ -0,0 +1,189 @@
+#ifndef FRAME_RECORDING_H
+#define FRAME_RECORDING_H
+
+#include <opencv2/core/mat.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+  * @brief Recording of the frames the OCR worker processed, for offline replay and benchmarks.
+  *
+  * Append-only: a file header, then one record per settings change and per frame, then an
+  * index of the frames written when the recording is closed. Frames are 8-bit luminance. A
+  * keyframe is run-length encoded on its own, the frames up to the next one as the run-length
+  * encoded difference to the frame before, which is mostly zeros for overlays and scoreboards.
+  * A recording that wasn't closed, e.g. after a crash, has no index and is read by walking the
+  * records. Integers are stored in the byte order of the machine, little-endian on every
+  * platform OBS runs on.
+*/
+
+constexpr uint32_t FRAME_RECORDING_MAGIC = 0x5252434f; // "OCRR"
+constexpr uint32_t FRAME_RECORDING_VERSION = 1;
+constexpr uint32_t FRAME_RECORD_MAGIC = 0x314d5246; // "FRM1"
+constexpr uint32_t FRAME_INDEX_MAGIC = 0x31584449;  // "IDX1"
+
+constexpr uint32_t FRAME_RECORD_SETTINGS = 1;
+constexpr uint32_t FRAME_RECORD_KEYFRAME = 2;
+constexpr uint32_t FRAME_RECORD_DELTA = 3;
+
+struct frame_recording_header {
+	uint32_t magic;
+	uint32_t version;
+	// frames from one keyframe to the next
+	uint32_t keyframe_interval;
+	uint32_t reserved;
+};
+
+struct frame_record_header {
+	uint32_t magic;
+	uint32_t type;
+	// OBS video timestamp of the frame, or the time of the settings change
+	uint64_t timestamp_ns;
+	// 0 for settings records, their payload is the filter settings as JSON
+	uint32_t width;
+	uint32_t height;
+	uint32_t payload_size;
+	uint32_t reserved;
+};
+
+struct frame_index_entry {
+	// file offsets of the frame's record, the keyframe it is decoded from and the settings
+	// record in effect, 0 if none
+	uint64_t offset;
+	uint64_t timestamp_ns;
+	uint64_t keyframe_offset;
+	uint64_t settings_offset;
+};
+
+struct frame_index_footer {
+	uint32_t magic;
+	uint32_t reserved;
+	uint64_t index_offset;
+	uint64_t frame_count;
+};
+
+static_assert(sizeof(frame_recording_header) == 16, "unexpected padding");
+static_assert(sizeof(frame_record_header) == 32, "unexpected padding");
+static_assert(sizeof(frame_index_entry) == 32, "unexpected padding");
+static_assert(sizeof(frame_index_footer) == 24, "unexpected padding");
+
+/**
+  * @brief Run-length encode bytes: a token below 128 is followed by token + 1 literal bytes,
+  * a token from 128 to 254 stands for token - 125 copies of the byte that follows, and 255 for
+  * as many copies as the 16-bit count after it
+*/
+void frame_rle_encode(const uint8_t *data, size_t size, std::vector<uint8_t> &out);
+
+/**
+  * @brief Decode exactly outSize bytes
+  * @return false if the encoded data is corrupt or doesn't have outSize bytes
+*/
+bool frame_rle_decode(const uint8_t *data, size_t size, uint8_t *out, size_t outSize);
+
+/**
+  * @brief Writes a recording. Only used by the worker thread of one filter.
+*/
+class FrameRecordingWriter {
+public:
+	FrameRecordingWriter() = default;
+	~FrameRecordingWriter();
+	FrameRecordingWriter(const FrameRecordingWriter &) = delete;
+	FrameRecordingWriter &operator=(const FrameRecordingWriter &) = delete;
+
+	bool open(const std::string &path, uint32_t keyframeInterval = 30);
+
+	/**
+	  * @brief Write the index and close the file
+	*/
+	void close();
+	bool is_open() const { return file.is_open(); }
+
+	/**
+	  * @brief Record the settings the following frames were processed with
+	*/
+	void write_settings(const std::string &json, uint64_t timestampNs);
+
+	/**
+	  * @param gray 8-bit single channel frame
+	*/
+	void write_frame(const cv::Mat &gray, uint64_t timestampNs);
+
+	uint64_t size() const { return offset; }
+
+private:
+	void write_record(uint32_t type, uint64_t timestampNs, uint32_t width, uint32_t height,
+			  const uint8_t *payload, size_t payloadSize);
+
+	std::ofstream file;
+	uint64_t offset = 0;
+	uint32_t keyframeInterval = 30;
+	uint32_t framesSinceKeyframe = 0;
+	uint64_t keyframeOffset = 0;
+	uint64_t settingsOffset = 0;
+	cv::Mat previous;
+	std::vector<uint8_t> difference;
+	std::vector<uint8_t> encoded;
+	std::vector<frame_index_entry> index;
+};
+
+/**
+  * @brief Reads a recording through a read-only memory mapping, frames in order are decoded
+  * from the one before, a seek decodes from the keyframe before it
+*/
+class FrameRecordingReader {
+public:
+	FrameRecordingReader() = default;
+	~FrameRecordingReader();
+	FrameRecordingReader(const FrameRecordingReader &) = delete;
+	FrameRecordingReader &operator=(const FrameRecordingReader &) = delete;
+
+	/**
+	  * @return false if the file can't be mapped or isn't a recording
+	*/
+	bool open(const std::string &path);
+	void close();
+	bool is_open() const { return data != nullptr; }
+
+	size_t frame_count() const { return index.size(); }
+	uint64_t timestamp_ns(size_t frame) const { return index[frame].timestamp_ns; }
+
+	/**
+	  * @brief Decode a frame into gray
+	  * @return false if the frame's records are corrupt
+	*/
+	bool read_frame(size_t frame, cv::Mat &gray);
+
+	/**
+	  * @brief The settings the frame was processed with as JSON, empty if none were recorded
+	*/
+	std::string settings_json(size_t frame) const;
+
+private:
+	/**
+	  * @brief Copy the header of the record at offset, records aren't aligned in the file
+	  * @return false if there is no complete record at offset
+	*/
+	bool record_at(uint64_t offset, frame_record_header &record) const;
+	bool apply_record(uint64_t offset);
+	void build_index();
+
+	const uint8_t *data = nullptr;
+	size_t size = 0;
+	std::vector<frame_index_entry> index;
+	// the last decoded frame, the base of the next delta
+	cv::Mat current;
+	std::vector<uint8_t> difference;
+	size_t currentFrame = SIZE_MAX;
+#ifdef _WIN32
+	void *fileHandle = nullptr;
+	void *mapping = nullptr;
+#else
+	int fd = -1;
+#endif
+};
+
+#endif /* FRAME_RECORDING_H */
@@ -0,0 +1,238 @@
+#include "model-manager.h"
+#include "consts.h"
+#include "plugin-support.h"
+
+#include <obs-module.h>
+#include <util/pipe.h>
+
+#include <tesseract/baseapi.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+namespace {
+
+struct model_stats {
+	double loadMs = 0.0;
+	int64_t residentBytes = 0;
+	uint64_t fileBytes = 0;
+	uint64_t frames = 0;
+	double totalFrameMs = 0.0;
+	double maxFrameMs = 0.0;
+	uint64_t timeouts = 0;
+};
+
+std::mutex stats_mutex;
+// by language and variant
+std::map<std::pair<std::string, std::string>, model_stats> stats;
+
+std::thread conversion_thread;
+std::atomic<bool> converting{false};
+
+std::filesystem::path config_tessdata_folder()
+{
+	char *path = obs_module_config_path("tessdata");
+	const std::filesystem::path folder = path != nullptr ? path : "";
+	bfree(path);
+	return folder;
+}
+
+double megabytes(double bytes)
+{
+	return bytes / (1024.0 * 1024.0);
+}
+
+bool run_combine_tessdata(const std::filesystem::path &model)
+{
+	// converts the LSTM weights of the model to 8 bit integers, in place
+	const std::string command = "combine_tessdata -c \"" + model.string() + "\"";
+	os_process_pipe_t *pipe = os_process_pipe_create(command.c_str(), "r");
+	if (pipe == nullptr) {
+		return false;
+	}
+	uint8_t buffer[1024];
+	while (os_process_pipe_read(pipe, buffer, sizeof(buffer)) > 0) {
+	}
+	const int exitCode = os_process_pipe_destroy(pipe);
+	if (exitCode != 0) {
+		obs_log(LOG_ERROR,
+			"combine_tessdata failed (exit code %d), it comes with the Tesseract "
+			"training tools and has to be on the PATH",
+			exitCode);
+		return false;
+	}
+	return true;
+}
+
+void convert_model(const std::filesystem::path &source, const std::string &language)
+{
+	namespace fs = std::filesystem;
+	std::error_code ec;
+	const fs::path folder = config_tessdata_folder() / MODEL_VARIANT_INT;
+	fs::create_directories(folder, ec);
+	// convert a copy, the result only replaces an existing model once it loads
+	const std::string workLanguage = language + ".converting";
+	const fs::path work = folder / (workLanguage + ".traineddata");
+	const fs::path target = folder / (language + ".traineddata");
+	fs::copy_file(source, work, fs::copy_options::overwrite_existing, ec);
+	if (ec) {
+		obs_log(LOG_ERROR, "Failed to copy %s: %s", source.string().c_str(),
+			ec.message().c_str());
+		return;
+	}
+
+	bool converted = run_combine_tessdata(work);
+	if (converted) {
+		tesseract::TessBaseAPI api;
+		converted = api.Init(folder.string().c_str(), workLanguage.c_str(),
+				     tesseract::OEM_LSTM_ONLY) == 0;
+		api.End();
+		if (!converted) {
+			obs_log(LOG_ERROR, "The converted %s model doesn't load", language.c_str());
+		}
+	}
+	if (converted) {
+		fs::rename(work, target, ec);
+		converted = !ec;
+	}
+	if (!converted) {
+		fs::remove(work, ec);
+		return;
+	}
+	obs_log(LOG_INFO, "Converted %s to an integer model: %.1f MB, was %.1f MB, in %s",
+		language.c_str(), megabytes((double)fs::file_size(target, ec)),
+		megabytes((double)fs::file_size(source, ec)), target.string().c_str());
+}
+
+} // namespace
+
+std::string find_model_folder(const std::string &tessdataFolder, const std::string &variant,
+			      const std::string &language)
+{
+	namespace fs = std::filesystem;
+	if (variant.empty() || variant == MODEL_VARIANT_BEST) {
+		return tessdataFolder;
+	}
+	std::error_code ec;
+	for (const fs::path &folder :
+	     {fs::path(tessdataFolder) / variant, config_tessdata_folder() / variant}) {
+		if (fs::exists(folder / (language + ".traineddata"), ec)) {
+			return folder.string();
+		}
+	}
+	return "";
+}
+
+void record_model_load(const std::string &language, const std::string &variant, double loadMs,
+		       int64_t residentBytes, uint64_t fileBytes)
+{
+	std::lock_guard<std::mutex> lock(stats_mutex);
+	// a reload starts the latency over, the settings around it may have changed
+	model_stats &entry = stats[{language, variant}];
+	entry = model_stats();
+	entry.loadMs = loadMs;
+	entry.residentBytes = residentBytes;
+	entry.fileBytes = fileBytes;
+}
+
+void record_model_frame(const std::string &language, const std::string &variant,
+			double frameMs)
+{
+	std::lock_guard<std::mutex> lock(stats_mutex);
+	model_stats &entry = stats[{language, variant}];
+	entry.frames++;
+	entry.totalFrameMs += frameMs;
+	entry.maxFrameMs = std::max(entry.maxFrameMs, frameMs);
+}
+
+void record_model_timeout(const std::string &language, const std::string &variant)
+{
+	std::lock_guard<std::mutex> lock(stats_mutex);
+	stats[{language, variant}].timeouts++;
+}
+
+std::string model_report()
+{
+	std::lock_guard<std::mutex> lock(stats_mutex);
+	std::ostringstream report;
+	report.precision(1);
+	report << std::fixed;
+	for (const auto &[key, entry] : stats) {
+		report << key.first << " (" << key.second << "): loaded in " << entry.loadMs
+		       << " ms, " << megabytes((double)entry.fileBytes) << " MB on disk, "
+		       << megabytes((double)entry.residentBytes) << " MB resident";
+		if (entry.frames > 0) {
+			report << ", " << entry.frames << " frames, "
+			       << entry.totalFrameMs / (double)entry.frames << " ms per frame (max "
+			       << entry.maxFrameMs << " ms)";
+		}
+		if (entry.timeouts > 0) {
+			report << ", " << entry.timeouts << " over the deadline";
+		}
+		report << "\n";
+	}
+	return report.str();
+}
+
+bool model_conversion_available()
+{
+	const char *path = getenv("PATH");
+	if (path == nullptr) {
+		return false;
+	}
+#ifdef _WIN32
+	const char separator = ';';
+	const char *tool = "combine_tessdata.exe";
+#else
+	const char separator = ':';
+	const char *tool = "combine_tessdata";
+#endif
+	std::istringstream folders(path);
+	std::string folder;
+	std::error_code ec;
+	while (std::getline(folders, folder, separator)) {
+		if (!folder.empty() &&
+		    std::filesystem::is_regular_file(std::filesystem::path(folder) / tool, ec)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool start_model_conversion(const std::string &tessdataFolder, const std::string &language)
+{
+	const std::filesystem::path source =
+		std::filesystem::path(tessdataFolder) / (language + ".traineddata");
+	std::error_code ec;
+	if (language.empty() || !std::filesystem::exists(source, ec)) {
+		obs_log(LOG_WARNING, "No %s model to convert", language.c_str());
+		return false;
+	}
+	if (converting.exchange(true)) {
+		obs_log(LOG_WARNING, "A model conversion is already running");
+		return false;
+	}
+	if (conversion_thread.joinable()) {
+		conversion_thread.join();
+	}
+	obs_log(LOG_INFO, "Converting %s to an integer model", language.c_str());
+	conversion_thread = std::thread([source, language]() {
+		convert_model(source, language);
+		converting = false;
+	});
+	return true;
+}
+
+void stop_model_manager(void)
+{
+	if (conversion_thread.joinable()) {
+		conversion_thread.join();
+	}
+}
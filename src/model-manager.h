@@ -0,0 +1,70 @@
+#ifndef MODEL_MANAGER_H
+#define MODEL_MANAGER_H
+
+#ifdef __cplusplus
+
+#include <cstdint>
+#include <string>
+
+/**
+  * @brief Tesseract model variants of the same language, side by side.
+  *
+  * The best model is the <language>.traineddata in the tessdata folder. The fast and integer
+  * variants live in fast/ and int/ subfolders, of the tessdata folder or of tessdata/ in the
+  * module config folder, where converted models and user downloads go.
+*/
+
+/**
+  * @brief Folder to pass to TessBaseAPI::Init for a language in a variant
+  * @return the folder, empty when that variant of the language isn't installed
+*/
+std::string find_model_folder(const std::string &tessdataFolder, const std::string &variant,
+			      const std::string &language);
+
+/**
+  * @brief Record how long loading a model took and what it costs in memory
+  * @param residentBytes growth of the process resident size during the load, approximate
+  *                      when other threads allocate meanwhile
+*/
+void record_model_load(const std::string &language, const std::string &variant, double loadMs,
+		       int64_t residentBytes, uint64_t fileBytes);
+
+/**
+  * @brief Record the recognition time of one frame
+*/
+void record_model_frame(const std::string &language, const std::string &variant,
+			double frameMs);
+
+/**
+  * @brief Record a recognition that was abandoned at its deadline
+*/
+void record_model_timeout(const std::string &language, const std::string &variant);
+
+/**
+  * @brief One line per loaded model variant with its load time, memory and frame latency
+*/
+std::string model_report();
+
+/**
+  * @brief Whether Tesseract's combine_tessdata tool, which the conversion runs, is on the PATH.
+  * It comes with the Tesseract training tools, not with OBS or the plugin.
+*/
+bool model_conversion_available();
+
+/**
+  * @brief Convert the best model of a language to an integer model in the config folder, on a
+  * background thread, with Tesseract's combine_tessdata tool
+  * @return false if a conversion is already running or there is no best model
+*/
+bool start_model_conversion(const std::string &tessdataFolder, const std::string &language);
+
+extern "C" {
+#endif
+
+void stop_model_manager(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MODEL_MANAGER_H */
@@ -1,19 +1,33 @@
 #include "obs-utils.h"
 #include "plugin-support.h"
+#include "text-utils.h"
+#include "pipeline-trace.h"
 
 #include <obs-module.h>
+#include <util/platform.h>
 
 #include <QImage>
 #include <QString>
 
+#include <inja/inja.hpp>
+
 #include <opencv2/core.hpp>
 
 #include <string>
+#include <chrono>
 #include <filesystem>
 #include <mutex>
 #include <opencv2/imgproc.hpp>
 #include <fstream>
-#include <regex>
+
+cv::Rect2i get_crop_region(const cv::Rect2i &cropRegionRelative, const cv::Size &imageSize)
+{
+	// the relative width and height are negative offsets from the right and bottom edges
+	const cv::Rect2i cropRegion(cropRegionRelative.x, cropRegionRelative.y,
+				    imageSize.width + cropRegionRelative.width,
+				    imageSize.height + cropRegionRelative.height);
+	return cropRegion & cv::Rect2i(0, 0, imageSize.width, imageSize.height);
+}
 
 /**
   * @brief Get RGBA from the stage surface
@@ -40,20 +54,23 @@ bool getRGBAFromStageSurface(filter_data *tf, uint32_t &width, uint32_t &height)
 	if (width == 0 || height == 0) {
 		return false;
 	}
-	gs_texrender_reset(tf->texrender);
-	if (!gs_texrender_begin(tf->texrender, width, height)) {
-		return false;
+	{
+		TraceScope scope("capture");
+		gs_texrender_reset(tf->texrender);
+		if (!gs_texrender_begin(tf->texrender, width, height)) {
+			return false;
+		}
+		struct vec4 background;
+		vec4_zero(&background);
+		gs_clear(GS_CLEAR_COLOR, &background, 0.0f, 0);
+		gs_ortho(0.0f, static_cast<float>(width), 0.0f, static_cast<float>(height),
+			 -100.0f, 100.0f);
+		gs_blend_state_push();
+		gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+		obs_source_video_render(target);
+		gs_blend_state_pop();
+		gs_texrender_end(tf->texrender);
 	}
-	struct vec4 background;
-	vec4_zero(&background);
-	gs_clear(GS_CLEAR_COLOR, &background, 0.0f, 0);
-	gs_ortho(0.0f, static_cast<float>(width), 0.0f, static_cast<float>(height), -100.0f,
-		 100.0f);
-	gs_blend_state_push();
-	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
-	obs_source_video_render(target);
-	gs_blend_state_pop();
-	gs_texrender_end(tf->texrender);
 
 	if (tf->stagesurface) {
 		uint32_t stagesurf_width = gs_stagesurface_get_width(tf->stagesurface);
@@ -66,23 +83,45 @@ bool getRGBAFromStageSurface(filter_data *tf, uint32_t &width, uint32_t &height)
 	if (!tf->stagesurface) {
 		tf->stagesurface = gs_stagesurface_create(width, height, GS_BGRA);
 	}
-	gs_stage_texture(tf->stagesurface, gs_texrender_get_texture(tf->texrender));
+	{
+		TraceScope scope("staging");
+		gs_stage_texture(tf->stagesurface, gs_texrender_get_texture(tf->texrender));
+	}
+	// the map waits for the GPU to finish the copy
+	TraceScope mapScope("mapping");
 	uint8_t *video_data;
 	uint32_t linesize;
 	if (!gs_stagesurface_map(tf->stagesurface, &video_data, &linesize)) {
 		return false;
 	}
 	{
-		std::lock_guard<std::mutex> lock(tf->inputBGRALock);
-		tf->inputBGRA = cv::Mat(height, width, CV_8UC4, video_data, linesize);
+		const cv::Mat frame(height, width, CV_8UC4, video_data, linesize);
+		const cv::Rect2i crop =
+			get_crop_region(get_ocr_settings(tf)->cropRegionRelative, frame.size());
+		std::lock_guard<std::mutex> lock(tf->inputGrayLock);
+		// convert out of the mapped memory, it is only valid until the unmap below. The
+		// pipeline only needs the luminance of the crop region, a quarter of its bytes
+		if (crop.empty()) {
+			tf->inputGray.release();
+		} else {
+			cv::cvtColor(frame(crop), tf->inputGray, cv::COLOR_BGRA2GRAY);
+		}
+		tf->inputCropOffset = crop.tl();
+		tf->inputTimestampNs = obs_get_video_frame_time();
 	}
 	gs_stagesurface_unmap(tf->stagesurface);
+	{
+		// under the lock, so that the waiting worker doesn't miss it
+		std::lock_guard<std::mutex> lock(tf->tesseract_mutex);
+		tf->inputFrameSequence++;
+		tf->tesseract_thread_cv.notify_all();
+	}
 	return true;
 }
 
 /*            OUTPUT TEXT SOURCE UTIL             */
 
-void acquire_weak_output_source_ref(struct filter_data *usd, char *output_source_name_for_ref,
+void acquire_weak_output_source_ref(struct filter_data *usd, const char *output_source_name_for_ref,
 				    obs_weak_source_t **output_source)
 {
 	if (!is_valid_output_source_name(output_source_name_for_ref)) {
@@ -112,7 +151,8 @@ void acquire_weak_output_source_ref(struct filter_data *usd, char *output_source
 	}
 }
 
-void setTextCallback(const std::string &str_in, struct filter_data *usd)
+void setTextCallback(const std::string &str_in, const ocr_settings &settings,
+		     struct filter_data *usd)
 {
 	if (!usd->output_source_mutex) {
 		obs_log(LOG_ERROR, "output_source_mutex is null");
@@ -120,14 +160,8 @@ void setTextCallback(const std::string &str_in, struct filter_data *usd)
 	}
 
 	std::string str = str_in;
-	if (usd->output_flatten) {
-		// remove newlines and tabs, replace with spaces
-		std::replace(str.begin(), str.end(), '\n', ' ');
-		std::replace(str.begin(), str.end(), '\t', ' ');
-		std::replace(str.begin(), str.end(), '\r', ' ');
-
-		// remove multiple spaces
-		str = std::regex_replace(str, std::regex(" +"), " ");
+	if (settings.output_flatten) {
+		flatten_text(str);
 	}
 
 	// update internal settings
@@ -136,17 +170,18 @@ void setTextCallback(const std::string &str_in, struct filter_data *usd)
 	obs_data_release(internal_source_settings);
 
 	// check if save_to_file is selected
-	if (strcmp(usd->output_source_name, "!!save_to_file!!") == 0) {
+	if (settings.output_source_name == "!!save_to_file!!") {
 		// save_to_file is selected, write the text to a file
-		if (usd->output_file_path.empty()) {
+		if (settings.output_file_path.empty()) {
 			return;
 		}
-		// append flag according to tf->output_file_append
-		std::ofstream file(usd->output_file_path, usd->output_file_append
-								  ? std::ios_base::app
-								  : std::ios_base::trunc);
+		// append flag according to settings.output_file_append
+		std::ofstream file(settings.output_file_path, settings.output_file_append
+								      ? std::ios_base::app
+								      : std::ios_base::trunc);
 		if (!file.is_open()) {
-			obs_log(LOG_ERROR, "failed to open file %s", usd->output_file_path.c_str());
+			obs_log(LOG_ERROR, "failed to open file %s",
+				settings.output_file_path.c_str());
 			return;
 		}
 		file << str;
@@ -156,7 +191,8 @@ void setTextCallback(const std::string &str_in, struct filter_data *usd)
 
 	if (!usd->output_source) {
 		// attempt to acquire a weak ref to the text source if it's yet available
-		acquire_weak_output_source_ref(usd, usd->output_source_name, &(usd->output_source));
+		acquire_weak_output_source_ref(usd, settings.output_source_name.c_str(),
+					       &(usd->output_source));
 	}
 
 	std::lock_guard<std::mutex> lock(*usd->output_source_mutex);
@@ -178,7 +214,8 @@ void setTextCallback(const std::string &str_in, struct filter_data *usd)
 	obs_source_release(target);
 };
 
-void setTextDetectionMaskCallback(const cv::Mat &mask_rgba, struct filter_data *usd)
+void setTextDetectionMaskCallback(const cv::Mat &mask_rgba, const ocr_settings &settings,
+				  struct filter_data *usd)
 {
 	UNUSED_PARAMETER(mask_rgba);
 	if (!usd->output_source_mutex) {
@@ -188,7 +225,7 @@ void setTextDetectionMaskCallback(const cv::Mat &mask_rgba, struct filter_data *
 
 	if (!usd->output_image_source) {
 		// attempt to acquire a weak ref to the image source if it's yet available
-		acquire_weak_output_source_ref(usd, usd->output_image_source_name,
+		acquire_weak_output_source_ref(usd, settings.output_image_source_name.c_str(),
 					       &(usd->output_image_source));
 	}
 
@@ -243,6 +280,58 @@ bool add_sources_to_list(void *list_property, obs_source_t *source,
 	return true;
 }
 
+std::string format_text_with_template(inja::Environment &env, const std::string &text,
+				      const std::string &templateText, uint64_t frame_timestamp_ns)
+{
+	// Replace the {{output}} placeholder with the source text using inja
+	nlohmann::json data;
+	data["output"] = text;
+	// the frame's OBS video time, and the same moment on the wall clock
+	const uint64_t frame_age_ns = os_gettime_ns() - frame_timestamp_ns;
+	const uint64_t now_unix_ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+					     std::chrono::system_clock::now().time_since_epoch())
+					     .count();
+	data["frame_time_ms"] = frame_timestamp_ns / 1000000;
+	data["frame_unix_ms"] = (now_unix_ns - frame_age_ns) / 1000000;
+	return env.render(templateText, data);
+}
+
+std::string ocr_boxes_to_json(const std::vector<OCRBox> &boxes)
+{
+	nlohmann::json json = nlohmann::json::array();
+	for (const OCRBox &box : boxes) {
+		nlohmann::json item;
+		item["text"] = box.text;
+		item["x"] = box.box.x;
+		item["y"] = box.box.y;
+		item["width"] = box.box.width;
+		item["height"] = box.box.height;
+		json.push_back(item);
+	}
+	return json.dump();
+}
+
+void emitOcrResultSignal(struct filter_data *usd, ocr_result_event event)
+{
+	{
+		std::lock_guard<std::mutex> lock(usd->last_result_mutex);
+		event.sequence = usd->last_result.sequence + 1;
+		usd->last_result = event;
+	}
+
+	const std::string boxes = ocr_boxes_to_json(event.boxes);
+	calldata_t cd;
+	calldata_init(&cd);
+	calldata_set_ptr(&cd, "source", usd->source);
+	calldata_set_string(&cd, "text", event.text.c_str());
+	calldata_set_int(&cd, "confidence", event.confidence);
+	calldata_set_string(&cd, "boxes", boxes.c_str());
+	calldata_set_int(&cd, "frame_timestamp", (long long)event.frame_timestamp_ns);
+	calldata_set_int(&cd, "sequence", (long long)event.sequence);
+	signal_handler_signal(obs_source_get_signal_handler(usd->source), "ocr_result", &cd);
+	calldata_free(&cd);
+}
+
 bool add_text_sources_to_list(void *list_property, obs_source_t *source)
 {
 	return add_sources_to_list(list_property, source, {"text_"});
@@ -299,7 +388,6 @@ void update_text_source_on_settings(struct filter_data *usd, obs_data_t *setting
 		// text_sources is not pointing to !!save_to_file!!, update the selected text source
 		update_output_source_on_settings(usd, settings, "text_sources", &usd->output_source,
 						 &usd->output_source_name);
-		usd->output_file_path = "";
 	} else {
 		// text_sources is pointing to !!save_to_file!!, release the selected text source
 		if (usd->output_source) {
@@ -307,8 +395,10 @@ void update_text_source_on_settings(struct filter_data *usd, obs_data_t *setting
 			obs_weak_source_release(usd->output_source);
 			usd->output_source = nullptr;
 		}
+		if (usd->output_source_name) {
+			bfree(usd->output_source_name);
+		}
 		usd->output_source_name = bstrdup(text_sources);
-		usd->output_file_path = obs_data_get_string(settings, "output_file_path");
 	}
 }
 
@@ -3,6 +3,15 @@
 
 #include "filter-data.h"
 
+namespace inja {
+class Environment;
+}
+
+/**
+  * @brief The crop region of the settings in a frame of imageSize, empty if nothing is left
+*/
+cv::Rect2i get_crop_region(const cv::Rect2i &cropRegionRelative, const cv::Size &imageSize);
+
 bool getRGBAFromStageSurface(filter_data *tf, uint32_t &width, uint32_t &height);
 
 inline bool is_valid_output_source_name(const char *output_source_name)
@@ -13,8 +22,22 @@ inline bool is_valid_output_source_name(const char *output_source_name)
 
 void acquire_weak_output_source_ref(struct filter_data *usd);
 
-void setTextCallback(const std::string &str, struct filter_data *usd);
-void setTextDetectionMaskCallback(const cv::Mat &mask, struct filter_data *usd);
+void setTextCallback(const std::string &str, const ocr_settings &settings,
+		     struct filter_data *usd);
+void setTextDetectionMaskCallback(const cv::Mat &mask, const ocr_settings &settings,
+				  struct filter_data *usd);
+
+/**
+  * @brief Store a result as the latest one and emit it with the filter's ocr_result signal
+*/
+void emitOcrResultSignal(struct filter_data *usd, ocr_result_event event);
+std::string ocr_boxes_to_json(const std::vector<OCRBox> &boxes);
+
+/**
+  * @brief Render an output template with the text and the frame's timestamps
+*/
+std::string format_text_with_template(inja::Environment &env, const std::string &text,
+				      const std::string &templateText, uint64_t frame_timestamp_ns);
 
 bool add_text_sources_to_list(void *list_property, obs_source_t *source);
 
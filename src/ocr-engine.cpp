@@ -0,0 +1,103 @@
+#include "ocr-engine.h"
+#include "consts.h"
+#include "plugin-support.h"
+#include "seven-segment.h"
+
+#include <obs-module.h>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace {
+
+class SevenSegmentEngine : public OcrEngine {
+public:
+	const char *name() const override { return "Seven-segment"; }
+
+	void configure(const ocr_settings &) override {}
+
+	bool recognize(const ocr_request &request, const ocr_settings &settings,
+		       ocr_engine_result &result) override
+	{
+		// the cells are given in cropped frame coordinates
+		std::vector<cv::Rect> cells;
+		for (const cv::Rect &cell : settings.sevenSegmentCells) {
+			cells.push_back(cv::Rect((int)((double)cell.x * request.scale),
+						 (int)((double)cell.y * request.scale),
+						 (int)((double)cell.width * request.scale),
+						 (int)((double)cell.height * request.scale)));
+		}
+		const std::vector<SevenSegmentDecoder::Digit> &digits =
+			decoder.decode(request.image, cells);
+
+		std::string text = seven_segment_text(digits, result.confidence);
+		if (result.confidence >= settings.conf_threshold) {
+			result.text = text;
+		}
+		for (const SevenSegmentDecoder::Digit &digit : digits) {
+			result.boxes.push_back(OCRBox{std::string(1, digit.character), digit.cell});
+		}
+		return true;
+	}
+
+	void warm_up() override {}
+
+private:
+	SevenSegmentDecoder decoder;
+};
+
+} // namespace
+
+void OcrEngine::warm_up()
+{
+	cv::Mat image(48, 160, CV_8UC1, cv::Scalar(255));
+	cv::putText(image, "0123", cv::Point(8, 36), cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0),
+		    2);
+	ocr_request request;
+	request.image = image;
+	ocr_settings settings;
+	settings.conf_threshold = 0;
+	ocr_engine_result result;
+	recognize(request, settings, result);
+}
+
+bool ocr_engine_changed(const ocr_settings &a, const ocr_settings &b)
+{
+	if (a.ocr_engine != b.ocr_engine) {
+		return true;
+	}
+	switch (a.ocr_engine) {
+	case OCR_ENGINE_TESSERACT:
+		// the language and the user patterns can only be set when the model is loaded
+		return a.language != b.language || a.user_patterns != b.user_patterns ||
+		       a.model_variant != b.model_variant ||
+		       (a.language == AUTO_LANGUAGE && a.auto_languages != b.auto_languages);
+	case OCR_ENGINE_CRNN:
+		return a.crnn_model != b.crnn_model;
+	default:
+		return false;
+	}
+}
+
+std::unique_ptr<OcrEngine> create_ocr_engine(filter_data *tf, const ocr_settings &settings)
+{
+	switch (settings.ocr_engine) {
+	case OCR_ENGINE_TESSERACT:
+		if (settings.language == AUTO_LANGUAGE) {
+			return create_auto_language_engine(tf, settings);
+		}
+		return create_tesseract_engine(tf, settings);
+	case OCR_ENGINE_SEVEN_SEGMENT:
+		return std::make_unique<SevenSegmentEngine>();
+	case OCR_ENGINE_CRNN:
+#ifdef ENABLE_OPENCV_DNN
+		return create_crnn_engine(tf, settings);
+#else
+		obs_log(LOG_ERROR, "The CRNN engine needs a build with ENABLE_OPENCV_DNN");
+		return nullptr;
+#endif
+	default:
+		obs_log(LOG_ERROR, "Unknown OCR engine %d", settings.ocr_engine);
+		return nullptr;
+	}
+}
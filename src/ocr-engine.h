@@ -0,0 +1,107 @@
+#ifndef OCR_ENGINE_H
+#define OCR_ENGINE_H
+
+#include <opencv2/core/mat.hpp>
+
+#include "ocr-settings.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct filter_data;
+
+struct OCRBox {
+	std::string text;
+	cv::Rect box;
+};
+
+/**
+  * @brief One recognition request from the worker
+*/
+struct ocr_request {
+	// the preprocessed image
+	cv::Mat image;
+	// candidate text lines in image coordinates from the detection prepass, recognized one by
+	// one when not null
+	const std::vector<cv::Rect> *lines = nullptr;
+	// image size relative to the cropped frame, for settings given in frame coordinates
+	double scale = 1.0;
+	// whether the word/line boxes are needed, e.g. for the detection mask output
+	bool wantBoxes = false;
+	// whether the text lines found by a full page analysis are needed, for layout caching
+	bool wantLines = false;
+	// time the engine may spend on the request, 0 for no limit
+	uint32_t deadlineMs = 0;
+};
+
+struct ocr_engine_result {
+	// recognized text that passed the confidence threshold, not stripped or smoothed yet
+	std::string text;
+	// 0-100
+	int confidence = 0;
+	// boxes in image coordinates, only filled when requested
+	std::vector<OCRBox> boxes;
+	// text lines in image coordinates, only filled when requested and the engine analyzes the
+	// page layout
+	std::vector<cv::Rect> lines;
+	// recognition was abandoned at the deadline, the rest of the result is incomplete
+	bool timedOut = false;
+};
+
+/**
+  * @brief A recognition backend. Engines are created (and their models loaded) on a loader
+  * thread, then owned and used by the worker thread only.
+*/
+class OcrEngine {
+public:
+	virtual ~OcrEngine() = default;
+
+	virtual const char *name() const = 0;
+
+	/**
+	  * @brief Apply the settings that don't need a new engine (segmentation mode, whitelist)
+	*/
+	virtual void configure(const ocr_settings &settings) = 0;
+
+	/**
+	  * @brief Recognize the text in a request
+	  * @return false if recognition failed
+	*/
+	virtual bool recognize(const ocr_request &request, const ocr_settings &settings,
+			       ocr_engine_result &result) = 0;
+
+	/**
+	  * @brief Run a throwaway recognition so that the first real frame doesn't pay for lazy
+	  * allocations
+	*/
+	virtual void warm_up();
+};
+
+/**
+  * @brief Whether two settings snapshots need different engines (engine type or model)
+*/
+bool ocr_engine_changed(const ocr_settings &a, const ocr_settings &b);
+
+/**
+  * @brief Create the engine selected in the settings and load its model. Slow, call it off the
+  * worker thread.
+  * @return nullptr if the engine could not be created
+*/
+std::unique_ptr<OcrEngine> create_ocr_engine(filter_data *tf, const ocr_settings &settings);
+
+/**
+  * @brief Parse the candidate languages of the automatic language selection, e.g. "eng, jpn"
+*/
+std::vector<std::string> parse_auto_languages(const std::string &spec);
+
+// engine implementations, created through create_ocr_engine
+std::unique_ptr<OcrEngine> create_tesseract_engine(filter_data *tf, const ocr_settings &settings);
+std::unique_ptr<OcrEngine> create_auto_language_engine(filter_data *tf,
+						       const ocr_settings &settings);
+#ifdef ENABLE_OPENCV_DNN
+std::unique_ptr<OcrEngine> create_crnn_engine(filter_data *tf, const ocr_settings &settings);
+#endif
+
+#endif /* OCR_ENGINE_H */
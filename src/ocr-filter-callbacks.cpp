@@ -1,6 +1,10 @@
 
 #include "filter-data.h"
 #include "plugin-support.h"
+#include "tesseract-ocr-utils.h"
+#include "obs-utils.h"
+#include "pipeline-trace.h"
+#include "model-manager.h"
 
 #include <obs.h>
 
@@ -15,4 +19,43 @@ void enable_callback(void *data_, calldata_t *cd)
 		obs_log(LOG_INFO, "enable_callback: disable");
 		gf_->isDisabled = true;
 	}
+	notify_tesseract_thread(gf_);
+}
+
+void get_last_ocr_result_proc(void *data_, calldata_t *cd)
+{
+	filter_data *gf_ = static_cast<struct filter_data *>(data_);
+	ocr_result_event last_result;
+	{
+		std::lock_guard<std::mutex> lock(gf_->last_result_mutex);
+		last_result = gf_->last_result;
+	}
+	calldata_set_string(cd, "text", last_result.text.c_str());
+	calldata_set_int(cd, "confidence", last_result.confidence);
+	calldata_set_string(cd, "boxes", ocr_boxes_to_json(last_result.boxes).c_str());
+	calldata_set_int(cd, "frame_timestamp", (long long)last_result.frame_timestamp_ns);
+	calldata_set_int(cd, "sequence", (long long)last_result.sequence);
+}
+
+void trigger_ocr_proc(void *data_, calldata_t *cd)
+{
+	UNUSED_PARAMETER(cd);
+	filter_data *gf_ = static_cast<struct filter_data *>(data_);
+	gf_->ocr_triggered = true;
+	// cut the worker's sleep short, the result arrives through the ocr_result signal
+	notify_tesseract_thread(gf_);
+}
+
+void dump_trace_proc(void *data_, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data_);
+	// the trace covers all filters, empty path if it couldn't be written
+	calldata_set_string(cd, "path", trace_dump_to_config_folder().c_str());
+}
+
+void model_report_proc(void *data_, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data_);
+	// the models loaded by all filters, one per line
+	calldata_set_string(cd, "report", model_report().c_str());
 }
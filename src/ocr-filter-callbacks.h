@@ -3,3 +3,7 @@
 #include <callback/calldata.h>
 
 void enable_callback(void *data_, calldata_t *cd);
+void get_last_ocr_result_proc(void *data_, calldata_t *cd);
+void trigger_ocr_proc(void *data_, calldata_t *cd);
+void dump_trace_proc(void *data_, calldata_t *cd);
+void model_report_proc(void *data_, calldata_t *cd);
@@ -12,5 +12,7 @@ struct obs_source_info ocr_filter_info = {
 	.update = ocr_filter_update,
 	.activate = ocr_filter_activate,
 	.deactivate = ocr_filter_deactivate,
+	.show = ocr_filter_show,
+	.hide = ocr_filter_hide,
 	.video_render = ocr_filter_video_render,
 };
@@ -9,6 +9,10 @@
 #include "consts.h"
 #include "obs-utils.h"
 #include "ocr-filter.h"
+#include "auto-tuner.h"
+#include "cpu-budget.h"
+#include "pipeline-trace.h"
+#include "model-manager.h"
 
 bool update_on_change_modified(obs_properties_t *props, obs_property_t *property,
 			       obs_data_t *settings)
@@ -50,6 +54,29 @@ bool rescale_modified(obs_properties_t *props_modified, obs_property_t *property
 	bool rescale_image = obs_data_get_bool(settings, "rescale_image");
 	obs_property_set_visible(obs_properties_get(props_modified, "rescale_target_size"),
 				 rescale_image);
+	obs_property_set_visible(obs_properties_get(props_modified, "rescale_auto"),
+				 rescale_image);
+	UNUSED_PARAMETER(property);
+	return true;
+}
+
+bool ocr_engine_modified(obs_properties_t *props, obs_property_t *property,
+			 obs_data_t *settings)
+{
+	// the seven-segment decoder needs no model, only the cells
+	const int engine = (int)obs_data_get_int(settings, "ocr_engine");
+	obs_property_set_visible(obs_properties_get(props, "language"),
+				 engine == OCR_ENGINE_TESSERACT);
+	obs_property_set_visible(obs_properties_get(props, "model_variant"),
+				 engine == OCR_ENGINE_TESSERACT);
+	obs_property_set_visible(obs_properties_get(props, "auto_languages"),
+				 engine == OCR_ENGINE_TESSERACT &&
+					 strcmp(obs_data_get_string(settings, "language"),
+						AUTO_LANGUAGE) == 0);
+	obs_property_set_visible(obs_properties_get(props, "seven_segment_cells"),
+				 engine == OCR_ENGINE_SEVEN_SEGMENT);
+	obs_property_set_visible(obs_properties_get(props, "crnn_model"),
+				 engine == OCR_ENGINE_CRNN);
 	UNUSED_PARAMETER(property);
 	return true;
 }
@@ -69,9 +96,65 @@ void add_language_selection(obs_properties_t *props)
 		if (filename.find(".traineddata") != std::string::npos) {
 			obs_log(LOG_DEBUG, "Found traineddata file: %s", filename.c_str());
 			std::string language = filename.substr(0, filename.find(".traineddata"));
+			// the script detection model only serves the automatic selection
+			if (language == "osd") {
+				continue;
+			}
 			obs_property_list_add_string(lang_list, language.c_str(), language.c_str());
 		}
 	}
+	obs_property_list_add_string(lang_list, obs_module_text("AutoLanguage"), AUTO_LANGUAGE);
+	obs_property_set_modified_callback(lang_list, ocr_engine_modified);
+
+	obs_property_t *auto_languages = obs_properties_add_text(
+		props, "auto_languages", obs_module_text("AutoLanguages"), OBS_TEXT_DEFAULT);
+	obs_property_set_long_description(auto_languages,
+					  obs_module_text("AutoLanguagesDescription"));
+
+	obs_property_t *variant_list =
+		obs_properties_add_list(props, "model_variant", obs_module_text("ModelVariant"),
+					OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(variant_list, obs_module_text("ModelVariantBest"),
+				     MODEL_VARIANT_BEST);
+	obs_property_list_add_string(variant_list, obs_module_text("ModelVariantFast"),
+				     MODEL_VARIANT_FAST);
+	obs_property_list_add_string(variant_list, obs_module_text("ModelVariantInt"),
+				     MODEL_VARIANT_INT);
+	obs_property_set_long_description(variant_list,
+					  obs_module_text("ModelVariantDescription"));
+}
+
+void add_engine_selection(obs_properties_t *props)
+{
+	obs_property_t *engine_list =
+		obs_properties_add_list(props, "ocr_engine", obs_module_text("OcrEngine"),
+					OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(engine_list, obs_module_text("EngineTesseract"),
+				  OCR_ENGINE_TESSERACT);
+	obs_property_list_add_int(engine_list, obs_module_text("EngineSevenSegment"),
+				  OCR_ENGINE_SEVEN_SEGMENT);
+#ifdef ENABLE_OPENCV_DNN
+	obs_property_list_add_int(engine_list, obs_module_text("EngineCrnn"), OCR_ENGINE_CRNN);
+#endif
+	obs_property_set_modified_callback(engine_list, ocr_engine_modified);
+
+	obs_property_t *cells_property = obs_properties_add_text(
+		props, "seven_segment_cells", obs_module_text("SevenSegmentCells"),
+		OBS_TEXT_DEFAULT);
+	obs_property_set_long_description(cells_property,
+					  obs_module_text("SevenSegmentCellsDescription"));
+
+	// CRNN models are .onnx files in the tessdata folder, with a .txt vocabulary next to them
+	obs_property_t *crnn_list =
+		obs_properties_add_list(props, "crnn_model", obs_module_text("CrnnModel"),
+					OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+	std::string tessdata_folder = obs_module_file("tessdata");
+	for (const auto &entry : std::filesystem::directory_iterator(tessdata_folder)) {
+		if (entry.path().extension() == ".onnx") {
+			std::string model = entry.path().stem().string();
+			obs_property_list_add_string(crnn_list, model.c_str(), model.c_str());
+		}
+	}
 }
 
 void add_text_source_output(obs_properties_t *props)
@@ -191,12 +274,24 @@ void add_advanced_settings(obs_properties_t *props)
 						 "binarization_block_size",
 						 "rescale_image",
 						 "rescale_target_size",
+						 "rescale_auto",
+						 "recognition_deadline",
+						 "deadline_retry",
 						 "update_on_change_threshold",
 						 "dilation_iterations",
+						 "erosion_iterations",
+						 "denoise_kernel_size",
+						 "preprocessing_stages",
+						 "text_detection_prepass",
 						 "output_flatten",
+						 "output_targets",
 						 "char_whitelist_preset",
 						 "current_output",
-						 "crop_group"}) {
+						 "crop_group",
+						 "postprocess_group",
+						 "auto_tuner_group",
+						 "tracing_group",
+						 "models_group"}) {
 				obs_property_set_visible(obs_properties_get(props_modified, prop),
 							 advanced_settings);
 			}
@@ -211,6 +306,219 @@ void add_advanced_settings(obs_properties_t *props)
 		});
 }
 
+void add_auto_tuner(obs_properties_t *props, void *data)
+{
+	obs_properties_t *tuner_props = obs_properties_create();
+	obs_properties_add_group(props, "auto_tuner_group", obs_module_text("AutoTunerGroup"),
+				 OBS_GROUP_NORMAL, tuner_props);
+
+	// folder of captured frames (PNG) with their expected text (TXT)
+	obs_properties_add_path(tuner_props, "tuner_samples_folder",
+				obs_module_text("TunerSamplesFolder"), OBS_PATH_DIRECTORY, nullptr,
+				nullptr);
+	obs_properties_add_button2(
+		tuner_props, "tuner_capture_sample", obs_module_text("TunerCaptureSample"),
+		[](obs_properties_t *, obs_property_t *, void *data_) {
+			capture_tuner_sample(reinterpret_cast<filter_data *>(data_));
+			return false;
+		},
+		data);
+	obs_properties_add_int_slider(tuner_props, "tuner_target_accuracy",
+				      obs_module_text("TunerTargetAccuracy"), 0, 100, 1);
+	obs_properties_add_button2(
+		tuner_props, "tuner_run", obs_module_text("TunerRun"),
+		[](obs_properties_t *, obs_property_t *, void *data_) {
+			start_auto_tuner(reinterpret_cast<filter_data *>(data_));
+			return false;
+		},
+		data);
+}
+
+/**
+  * @brief Show the plugin-wide budget in a filter's dialog as its defaults, which aren't saved
+  * with the scene collection, and drop any copy of it in the filter's own settings
+*/
+static void show_cpu_budget(obs_data_t *settings, const cpu_budget &budget)
+{
+	obs_data_set_default_int(settings, "cpu_max_ocr_threads", budget.max_ocr_threads);
+	obs_data_set_default_int(settings, "cpu_omp_threads", budget.omp_threads);
+	obs_data_set_default_int(settings, "cpu_opencv_threads", budget.opencv_threads);
+	obs_data_set_default_string(settings, "cpu_affinity", budget.affinity.c_str());
+	obs_data_set_default_int(settings, "cpu_priority", budget.priority);
+	for (const char *name : {"cpu_max_ocr_threads", "cpu_omp_threads", "cpu_opencv_threads",
+				 "cpu_affinity", "cpu_priority"}) {
+		obs_data_unset_user_value(settings, name);
+	}
+}
+
+bool cpu_budget_modified(obs_properties_t *props, obs_property_t *property,
+			 obs_data_t *settings)
+{
+	cpu_budget budget;
+	budget.max_ocr_threads = (int)obs_data_get_int(settings, "cpu_max_ocr_threads");
+	budget.omp_threads = (int)obs_data_get_int(settings, "cpu_omp_threads");
+	budget.opencv_threads = (int)obs_data_get_int(settings, "cpu_opencv_threads");
+	budget.affinity = obs_data_get_string(settings, "cpu_affinity");
+	budget.priority = (int)obs_data_get_int(settings, "cpu_priority");
+
+	const cpu_budget current = get_cpu_budget();
+	if (budget.max_ocr_threads != current.max_ocr_threads ||
+	    budget.omp_threads != current.omp_threads ||
+	    budget.opencv_threads != current.opencv_threads ||
+	    budget.affinity != current.affinity || budget.priority != current.priority) {
+		set_cpu_budget(budget);
+	}
+	// the edit lives in cpu-budget.json, not in this filter's settings
+	show_cpu_budget(settings, budget);
+	UNUSED_PARAMETER(props);
+	UNUSED_PARAMETER(property);
+	return false;
+}
+
+void add_cpu_budget(obs_properties_t *props, void *data)
+{
+	// the budget is plugin-wide, show the current values, also over a copy an older version
+	// saved in the filter's settings
+	filter_data *tf = reinterpret_cast<filter_data *>(data);
+	if (tf != nullptr) {
+		obs_data_t *settings = obs_source_get_settings(tf->source);
+		show_cpu_budget(settings, get_cpu_budget());
+		obs_data_release(settings);
+	}
+
+	obs_properties_t *budget_props = obs_properties_create();
+	obs_properties_add_group(props, "cpu_budget_group", obs_module_text("CpuBudgetGroup"),
+				 OBS_GROUP_NORMAL, budget_props);
+
+	obs_property_t *max_threads = obs_properties_add_int(
+		budget_props, "cpu_max_ocr_threads", obs_module_text("CpuMaxOcrThreads"), 0, 64, 1);
+	obs_property_t *omp_threads = obs_properties_add_int(
+		budget_props, "cpu_omp_threads", obs_module_text("CpuOmpThreads"), 0, 64, 1);
+	obs_property_t *opencv_threads =
+		obs_properties_add_int(budget_props, "cpu_opencv_threads",
+				       obs_module_text("CpuOpencvThreads"), 0, 64, 1);
+	obs_property_t *affinity = obs_properties_add_text(
+		budget_props, "cpu_affinity", obs_module_text("CpuAffinity"), OBS_TEXT_DEFAULT);
+	obs_property_set_long_description(affinity, obs_module_text("CpuAffinityDescription"));
+	obs_property_t *priority = obs_properties_add_list(
+		budget_props, "cpu_priority", obs_module_text("CpuPriority"), OBS_COMBO_TYPE_LIST,
+		OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(priority, obs_module_text("CpuPriorityNormal"),
+				  OCR_PRIORITY_NORMAL);
+	obs_property_list_add_int(priority, obs_module_text("CpuPriorityBelowNormal"),
+				  OCR_PRIORITY_BELOW_NORMAL);
+	obs_property_list_add_int(priority, obs_module_text("CpuPriorityLowest"),
+				  OCR_PRIORITY_LOWEST);
+
+	for (obs_property_t *property :
+	     {max_threads, omp_threads, opencv_threads, affinity, priority}) {
+		obs_property_set_modified_callback(property, cpu_budget_modified);
+	}
+}
+
+void add_tracing(obs_properties_t *props)
+{
+	obs_properties_t *tracing_props = obs_properties_create();
+	obs_properties_add_group(props, "tracing_group", obs_module_text("TracingGroup"),
+				 OBS_GROUP_NORMAL, tracing_props);
+
+	obs_property_t *enable_tracing = obs_properties_add_bool(
+		tracing_props, "enable_tracing", obs_module_text("EnableTracing"));
+	obs_property_set_long_description(enable_tracing,
+					  obs_module_text("EnableTracingDescription"));
+	obs_properties_add_button2(
+		tracing_props, "trace_dump", obs_module_text("TraceDump"),
+		[](obs_properties_t *, obs_property_t *, void *) {
+			trace_dump_to_config_folder();
+			return false;
+		},
+		nullptr);
+
+	obs_property_t *record_frames = obs_properties_add_bool(
+		tracing_props, "record_frames", obs_module_text("RecordFrames"));
+	obs_property_set_long_description(record_frames,
+					  obs_module_text("RecordFramesDescription"));
+}
+
+void add_model_manager(obs_properties_t *props, void *data)
+{
+	obs_properties_t *models_props = obs_properties_create();
+	obs_properties_add_group(props, "models_group", obs_module_text("ModelsGroup"),
+				 OBS_GROUP_NORMAL, models_props);
+
+	obs_property_t *convert = obs_properties_add_button2(
+		models_props, "model_convert", obs_module_text("ModelConvert"),
+		[](obs_properties_t *, obs_property_t *, void *data_) {
+			filter_data *tf = reinterpret_cast<filter_data *>(data_);
+			obs_data_t *settings = obs_source_get_settings(tf->source);
+			start_model_conversion(tf->tesseractTraineddataFilepath,
+					       obs_data_get_string(settings, "language"));
+			obs_data_release(settings);
+			return false;
+		},
+		data);
+	obs_property_set_long_description(convert, obs_module_text("ModelConvertDescription"));
+	if (!model_conversion_available()) {
+		// OBS doesn't ship the tool, say so up front rather than in the log after a click
+		obs_property_set_enabled(convert, false);
+		obs_properties_add_text(models_props, "model_convert_unavailable",
+					obs_module_text("ModelConvertUnavailable"), OBS_TEXT_INFO);
+	}
+	obs_properties_add_button2(
+		models_props, "model_report", obs_module_text("ModelReport"),
+		[](obs_properties_t *, obs_property_t *, void *) {
+			const std::string report = model_report();
+			obs_log(LOG_INFO, "Loaded models:\n%s",
+				report.empty() ? "none\n" : report.c_str());
+			return false;
+		},
+		nullptr);
+}
+
+void add_post_processing(obs_properties_t *props)
+{
+	obs_properties_t *postprocess_props = obs_properties_create();
+	obs_properties_add_group(props, "postprocess_group", obs_module_text("PostProcessGroup"),
+				 OBS_GROUP_NORMAL, postprocess_props);
+
+	// presets fill in the replacement table, like the whitelist presets
+	obs_property_t *preset = obs_properties_add_list(postprocess_props,
+							 "postprocess_replacements_preset",
+							 obs_module_text("ReplacementsPreset"),
+							 OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(preset, obs_module_text("SelectPresets"), "none");
+	obs_property_list_add_string(preset, obs_module_text("ConfusionsToDigits"),
+				     CONFUSIONS_TO_DIGITS);
+	obs_property_list_add_string(preset, obs_module_text("ConfusionsToLetters"),
+				     CONFUSIONS_TO_LETTERS);
+	obs_property_set_modified_callback(
+		preset, [](obs_properties_t *, obs_property_t *property, obs_data_t *settings) {
+			const char *selected_preset =
+				obs_data_get_string(settings, "postprocess_replacements_preset");
+			if (strcmp(selected_preset, "none") != 0) {
+				obs_data_set_string(settings, "postprocess_replacements",
+						    selected_preset);
+			}
+			UNUSED_PARAMETER(property);
+			return true;
+		});
+
+	obs_property_t *replacements = obs_properties_add_text(
+		postprocess_props, "postprocess_replacements", obs_module_text("Replacements"),
+		OBS_TEXT_DEFAULT);
+	obs_property_set_long_description(replacements,
+					  obs_module_text("ReplacementsDescription"));
+	obs_property_t *rules =
+		obs_properties_add_text(postprocess_props, "postprocess_rules",
+					obs_module_text("PostProcessRules"), OBS_TEXT_MULTILINE);
+	obs_property_set_long_description(rules, obs_module_text("PostProcessRulesDescription"));
+	obs_property_t *validation = obs_properties_add_text(
+		postprocess_props, "validation_pattern", obs_module_text("ValidationPattern"),
+		OBS_TEXT_DEFAULT);
+	obs_property_set_long_description(validation,
+					  obs_module_text("ValidationPatternDescription"));
+}
+
 void add_char_whitelist(obs_properties_t *props)
 {
 	// add preset selector for char whitelist
@@ -263,6 +571,7 @@ obs_properties_t *ocr_filter_properties(void *data)
 {
 	obs_properties_t *props = obs_properties_create();
 
+	add_engine_selection(props);
 	add_language_selection(props);
 
 	// Add update timer property
@@ -303,6 +612,49 @@ obs_properties_t *ocr_filter_properties(void *data)
 	obs_property_list_add_int(psm_list, "Sparse text with orientation",
 				  (long long)tesseract::PSM_SPARSE_TEXT_OSD);
 
+	// Add option to find text lines first and recognize them in single line mode
+	obs_property_t *prepass_property = obs_properties_add_bool(
+		props, "text_detection_prepass", obs_module_text("TextDetectionPrepass"));
+	obs_property_set_long_description(prepass_property,
+					  obs_module_text("TextDetectionPrepassDescription"));
+
+	// Add option to reuse the page layout across frames
+	obs_property_t *layout_cache_property =
+		obs_properties_add_bool(props, "layout_cache", obs_module_text("LayoutCache"));
+	obs_property_set_long_description(layout_cache_property,
+					  obs_module_text("LayoutCacheDescription"));
+	obs_properties_add_int(props, "layout_refresh_frames",
+			       obs_module_text("LayoutRefreshFrames"), 1, 1000, 1);
+	obs_property_set_modified_callback(
+		layout_cache_property,
+		[](obs_properties_t *props_modified, obs_property_t *property,
+		   obs_data_t *settings) {
+			obs_property_set_visible(obs_properties_get(props_modified,
+								    "layout_refresh_frames"),
+						 obs_data_get_bool(settings, "layout_cache"));
+			UNUSED_PARAMETER(property);
+			return true;
+		});
+
+	// Add a time limit per recognition, so that a pathological frame can't stall the OCR
+	obs_property_t *deadline_property =
+		obs_properties_add_int(props, "recognition_deadline",
+				       obs_module_text("RecognitionDeadline"), 0, 60000, 100);
+	obs_property_int_set_suffix(deadline_property, " ms");
+	obs_property_set_long_description(deadline_property,
+					  obs_module_text("RecognitionDeadlineDescription"));
+	obs_properties_add_bool(props, "deadline_retry", obs_module_text("DeadlineRetry"));
+	obs_property_set_modified_callback(
+		deadline_property,
+		[](obs_properties_t *props_modified, obs_property_t *property,
+		   obs_data_t *settings) {
+			obs_property_set_visible(
+				obs_properties_get(props_modified, "deadline_retry"),
+				obs_data_get_int(settings, "recognition_deadline") > 0);
+			UNUSED_PARAMETER(property);
+			return true;
+		});
+
 	// Add binarization options dropdown list
 	obs_property_t *binarization_list = obs_properties_add_list(
 		props, "binarization_mode", obs_module_text("BinarizationMode"),
@@ -330,6 +682,19 @@ obs_properties_t *ocr_filter_properties(void *data)
 	obs_properties_add_int_slider(props, "dilation_iterations",
 				      obs_module_text("DilationIterations"), 0, 10, 1);
 
+	// add erosion iterations and denoise kernel size, used by the erode and denoise stages
+	obs_properties_add_int_slider(props, "erosion_iterations",
+				      obs_module_text("ErosionIterations"), 0, 10, 1);
+	obs_properties_add_int_slider(props, "denoise_kernel_size",
+				      obs_module_text("DenoiseKernelSize"), 3, 9, 2);
+
+	// add the ordered list of preprocessing stages, empty keeps the default order
+	obs_property_t *stages_property = obs_properties_add_text(
+		props, "preprocessing_stages", obs_module_text("PreprocessingStages"),
+		OBS_TEXT_DEFAULT);
+	obs_property_set_long_description(stages_property,
+					  obs_module_text("PreprocessingStagesDescription"));
+
 	// Add option for previewing the binarization
 	obs_properties_add_bool(props, "preview_binarization",
 				obs_module_text("PreviewBinarization"));
@@ -341,18 +706,14 @@ obs_properties_t *ocr_filter_properties(void *data)
 	obs_properties_add_int_slider(props, "rescale_target_size",
 				      obs_module_text("RescaleTargetSize"), 10, 100, 1);
 
+	// scale to the text height rather than the crop height
+	obs_property_t *rescale_auto =
+		obs_properties_add_bool(props, "rescale_auto", obs_module_text("RescaleAuto"));
+	obs_property_set_long_description(rescale_auto, obs_module_text("RescaleAutoDescription"));
+
 	// add callback to enable or disable the rescale target size property
-	obs_property_set_modified_callback(
-		obs_properties_get(props, "rescale_image"),
-		[](obs_properties_t *props_modified, obs_property_t *property,
-		   obs_data_t *settings) {
-			bool rescale_image = obs_data_get_bool(settings, "rescale_image");
-			obs_property_set_visible(obs_properties_get(props_modified,
-								    "rescale_target_size"),
-						 rescale_image);
-			UNUSED_PARAMETER(property);
-			return true;
-		});
+	obs_property_set_modified_callback(obs_properties_get(props, "rescale_image"),
+					   rescale_modified);
 
 	add_char_whitelist(props);
 
@@ -369,6 +730,8 @@ obs_properties_t *ocr_filter_properties(void *data)
 				      1);
 	obs_property_set_modified_callback(enable_smoothing_property, enable_smoothing_modified);
 
+	add_post_processing(props);
+
 	// Output formatting
 	obs_properties_add_text(props, "output_formatting", obs_module_text("OutputFormatting"),
 				OBS_TEXT_MULTILINE);
@@ -378,6 +741,56 @@ obs_properties_t *ocr_filter_properties(void *data)
 	// add option to "flatten" the output text to a single line
 	obs_properties_add_bool(props, "output_flatten", obs_module_text("OutputFlatten"));
 
+	// more outputs of the same result, each with its own template
+	obs_property_t *output_targets = obs_properties_add_text(
+		props, "output_targets", obs_module_text("OutputTargets"), OBS_TEXT_MULTILINE);
+	obs_property_set_long_description(output_targets,
+					  obs_module_text("OutputTargetsDescription"));
+
+	// hold outputs back to a fixed latency after their frame so that overlays line up
+	obs_property_t *sync_output_property =
+		obs_properties_add_bool(props, "sync_output", obs_module_text("SyncOutput"));
+	obs_property_set_long_description(sync_output_property,
+					  obs_module_text("SyncOutputDescription"));
+	obs_properties_add_int(props, "sync_latency_ms", obs_module_text("SyncLatency"), 0, 10000,
+			       10);
+	obs_property_set_modified_callback(
+		sync_output_property,
+		[](obs_properties_t *props_modified, obs_property_t *property,
+		   obs_data_t *settings) {
+			obs_property_set_visible(obs_properties_get(props_modified,
+								    "sync_latency_ms"),
+						 obs_data_get_bool(settings, "sync_output"));
+			UNUSED_PARAMETER(property);
+			return true;
+		});
+
+	// publish results to other local processes
+	obs_property_t *publish_results_property = obs_properties_add_bool(
+		props, "publish_results", obs_module_text("PublishResults"));
+	obs_property_set_long_description(publish_results_property,
+					  obs_module_text("PublishResultsDescription"));
+	obs_property_t *publish_name = obs_properties_add_text(
+		props, "publish_name", obs_module_text("PublishName"), OBS_TEXT_DEFAULT);
+	obs_property_set_long_description(publish_name,
+					  obs_module_text("PublishNameDescription"));
+#ifndef _WIN32
+	obs_properties_add_bool(props, "publish_socket", obs_module_text("PublishSocket"));
+#endif
+	obs_property_set_modified_callback(
+		publish_results_property,
+		[](obs_properties_t *props_modified, obs_property_t *property,
+		   obs_data_t *settings) {
+			const bool publish_results = obs_data_get_bool(settings, "publish_results");
+			obs_property_set_visible(obs_properties_get(props_modified, "publish_name"),
+						 publish_results);
+			obs_property_set_visible(obs_properties_get(props_modified,
+								    "publish_socket"),
+						 publish_results);
+			UNUSED_PARAMETER(property);
+			return true;
+		});
+
 	// add current output text box, disabled by default
 	obs_properties_add_text(props, "current_output", obs_module_text("current_output"),
 				OBS_TEXT_DEFAULT);
@@ -398,13 +811,44 @@ obs_properties_t *ocr_filter_properties(void *data)
 	obs_properties_add_int(crop_group_props, "crop_bottom", obs_module_text("CropBottom"), 0,
 			       2000, 1);
 
+	// follow the text inside the crop region
+	obs_property_t *auto_roi_property =
+		obs_properties_add_bool(crop_group_props, "auto_roi", obs_module_text("AutoRoi"));
+	obs_property_set_long_description(auto_roi_property,
+					  obs_module_text("AutoRoiDescription"));
+	obs_properties_add_int(crop_group_props, "auto_roi_margin",
+			       obs_module_text("AutoRoiMargin"), 0, 500, 1);
+	obs_properties_add_int(crop_group_props, "auto_roi_refresh",
+			       obs_module_text("AutoRoiRefresh"), 1, 1000, 1);
+	obs_property_set_modified_callback(
+		auto_roi_property,
+		[](obs_properties_t *props_modified, obs_property_t *property,
+		   obs_data_t *settings) {
+			const bool auto_roi = obs_data_get_bool(settings, "auto_roi");
+			obs_property_set_visible(obs_properties_get(props_modified,
+								    "auto_roi_margin"),
+						 auto_roi);
+			obs_property_set_visible(obs_properties_get(props_modified,
+								    "auto_roi_refresh"),
+						 auto_roi);
+			UNUSED_PARAMETER(property);
+			return true;
+		});
+
+	add_auto_tuner(props, data);
+
+	add_cpu_budget(props, data);
+
+	add_tracing(props);
+
+	add_model_manager(props, data);
+
 	// Add a informative text about the plugin
 	obs_properties_add_text(
 		props, "info",
 		QString(PLUGIN_INFO_TEMPLATE).arg(PLUGIN_VERSION).toStdString().c_str(),
 		OBS_TEXT_INFO);
 
-	UNUSED_PARAMETER(data);
 	return props;
 }
 
@@ -413,16 +857,31 @@ void ocr_filter_defaults(obs_data_t *settings)
 	obs_data_set_default_int(settings, "update_timer", 100);
 	obs_data_set_default_bool(settings, "update_on_change", true);
 	obs_data_set_default_int(settings, "update_on_change_threshold", 15);
+	obs_data_set_default_int(settings, "ocr_engine", OCR_ENGINE_TESSERACT);
+	obs_data_set_default_string(settings, "seven_segment_cells", "");
+	obs_data_set_default_string(settings, "crnn_model", "");
 	obs_data_set_default_string(settings, "language", "eng");
+	obs_data_set_default_string(settings, "auto_languages", "eng,jpn");
+	obs_data_set_default_string(settings, "model_variant", MODEL_VARIANT_BEST);
 	obs_data_set_default_bool(settings, "advanced_settings", false);
 	obs_data_set_default_int(settings, "page_segmentation_mode", tesseract::PSM_AUTO);
+	obs_data_set_default_bool(settings, "text_detection_prepass", false);
+	obs_data_set_default_bool(settings, "layout_cache", false);
+	obs_data_set_default_int(settings, "layout_refresh_frames", 30);
+	obs_data_set_default_int(settings, "recognition_deadline", 0);
+	obs_data_set_default_bool(settings, "record_frames", false);
+	obs_data_set_default_bool(settings, "deadline_retry", true);
 	obs_data_set_default_int(settings, "binarization_mode", 0);
 	obs_data_set_default_int(settings, "binarization_threshold", 127);
 	obs_data_set_default_int(settings, "binarization_block_size", 15);
 	obs_data_set_default_bool(settings, "preview_binarization", false);
 	obs_data_set_default_int(settings, "dilation_iterations", 0);
+	obs_data_set_default_int(settings, "erosion_iterations", 1);
+	obs_data_set_default_int(settings, "denoise_kernel_size", 3);
+	obs_data_set_default_string(settings, "preprocessing_stages", "");
 	obs_data_set_default_bool(settings, "rescale_image", false);
 	obs_data_set_default_int(settings, "rescale_target_size", 35);
+	obs_data_set_default_bool(settings, "rescale_auto", false);
 	obs_data_set_default_string(settings, "text_sources", "none");
 	obs_data_set_default_string(settings, "text_detection_mask_sources", "none");
 	obs_data_set_default_string(settings, "char_whitelist",
@@ -435,10 +894,31 @@ void ocr_filter_defaults(obs_data_t *settings)
 	obs_data_set_default_int(settings, "image_output_option", 0);
 	obs_data_set_default_bool(settings, "output_file_append", false);
 	obs_data_set_default_bool(settings, "output_flatten", false);
+	obs_data_set_default_string(settings, "output_targets", "");
+	obs_data_set_default_string(settings, "postprocess_replacements_preset", "none");
+	obs_data_set_default_string(settings, "postprocess_replacements", "");
+	obs_data_set_default_string(settings, "postprocess_rules", "");
+	obs_data_set_default_string(settings, "validation_pattern", "");
+	obs_data_set_default_bool(settings, "sync_output", false);
+	obs_data_set_default_int(settings, "sync_latency_ms", 500);
+	obs_data_set_default_bool(settings, "publish_results", false);
+	obs_data_set_default_string(settings, "publish_name", "");
+	obs_data_set_default_bool(settings, "publish_socket", false);
+	obs_data_set_default_bool(settings, "enable_tracing", false);
 	obs_data_set_default_string(settings, "char_whitelist_preset", "none");
 	obs_data_set_default_string(settings, "current_output", "");
 	obs_data_set_default_int(settings, "crop_left", 0);
 	obs_data_set_default_int(settings, "crop_right", 0);
 	obs_data_set_default_int(settings, "crop_top", 0);
 	obs_data_set_default_int(settings, "crop_bottom", 0);
+	obs_data_set_default_bool(settings, "auto_roi", false);
+	obs_data_set_default_int(settings, "auto_roi_margin", 20);
+	obs_data_set_default_int(settings, "auto_roi_refresh", 10);
+	obs_data_set_default_string(settings, "tuner_samples_folder", "");
+	obs_data_set_default_int(settings, "tuner_target_accuracy", 90);
+	obs_data_set_default_int(settings, "cpu_max_ocr_threads", 0);
+	obs_data_set_default_int(settings, "cpu_omp_threads", 0);
+	obs_data_set_default_int(settings, "cpu_opencv_threads", 0);
+	obs_data_set_default_string(settings, "cpu_affinity", "");
+	obs_data_set_default_int(settings, "cpu_priority", OCR_PRIORITY_NORMAL);
 }
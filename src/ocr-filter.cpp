@@ -18,6 +18,8 @@
 #include "tesseract-ocr-utils.h"
 #include "ocr-filter.h"
 #include "ocr-filter-callbacks.h"
+#include "auto-tuner.h"
+#include "pipeline-trace.h"
 
 const char *ocr_filter_getname(void *unused)
 {
@@ -34,61 +36,54 @@ void ocr_filter_update(void *data, obs_data_t *settings)
 	// Update the output text detection mask image source
 	update_image_source_on_settings(tf, settings);
 
-	bool hard_tesseract_init_required = false;
+	std::shared_ptr<ocr_settings> snapshot = std::make_shared<ocr_settings>();
+	snapshot->version = ++tf->settings_version;
+	read_ocr_settings(settings, *snapshot);
 
-	std::string new_language = obs_data_get_string(settings, "language");
-	if (new_language != tf->language) {
-		// if the language changed, we need to reinitialize the tesseract model
-		hard_tesseract_init_required = true;
+	if (tf->output_source_name != nullptr) {
+		snapshot->output_source_name = tf->output_source_name;
 	}
-	tf->language = new_language;
-
-	tf->pageSegmentationMode = (int)obs_data_get_int(settings, "page_segmentation_mode");
-	tf->binarizationMode = (int)obs_data_get_int(settings, "binarization_mode");
-	tf->binarizationThreshold = (int)obs_data_get_int(settings, "binarization_threshold");
-	tf->binarizationBlockSize = (int)obs_data_get_int(settings, "binarization_block_size");
-	tf->previewBinarization = obs_data_get_bool(settings, "preview_binarization");
-	tf->dilationIterations = (int)obs_data_get_int(settings, "dilation_iterations");
-	tf->rescaleImage = obs_data_get_bool(settings, "rescale_image");
-	tf->rescaleTargetSize = (int)obs_data_get_int(settings, "rescale_target_size");
-	tf->char_whitelist = obs_data_get_string(settings, "char_whitelist");
-	tf->conf_threshold = (int)obs_data_get_int(settings, "conf_threshold");
-	tf->enable_smoothing = obs_data_get_bool(settings, "enable_smoothing");
-	tf->word_length = obs_data_get_int(settings, "word_length");
-	tf->window_size = obs_data_get_int(settings, "window_size");
-	tf->update_timer_ms = (uint32_t)obs_data_get_int(settings, "update_timer");
-	tf->output_format_template = obs_data_get_string(settings, "output_formatting");
-	tf->update_on_change = obs_data_get_bool(settings, "update_on_change");
-	tf->update_on_change_threshold =
-		(int)obs_data_get_int(settings, "update_on_change_threshold");
-	tf->output_image_option = (int)obs_data_get_int(settings, "image_output_option");
-	tf->output_file_append = obs_data_get_bool(settings, "output_file_append");
-	tf->output_flatten = obs_data_get_bool(settings, "output_flatten");
-
-	// set the crop region from the properties
-	tf->cropRegionRelative.x = (int)obs_data_get_int(settings, "crop_left");
-	tf->cropRegionRelative.y = (int)obs_data_get_int(settings, "crop_top");
-	tf->cropRegionRelative.width =
-		-(int)obs_data_get_int(settings, "crop_right") - tf->cropRegionRelative.x;
-	tf->cropRegionRelative.height =
-		-(int)obs_data_get_int(settings, "crop_bottom") - tf->cropRegionRelative.y;
-
-	// Initialize the Tesseract OCR model
-	initialize_tesseract_ocr(tf, hard_tesseract_init_required);
+	if (tf->output_image_source_name != nullptr) {
+		snapshot->output_image_source_name = tf->output_image_source_name;
+	}
+	if (snapshot->output_source_name == "!!save_to_file!!") {
+		snapshot->output_file_path = obs_data_get_string(settings, "output_file_path");
+	}
+
+	// publish, the worker picks the new snapshot up at the start of its next frame
+	std::atomic_store(&tf->settings, std::shared_ptr<const ocr_settings>(std::move(snapshot)));
 }
 
 void ocr_filter_activate(void *data)
 {
 	struct filter_data *tf = reinterpret_cast<filter_data *>(data);
 	obs_log(LOG_INFO, "ocr_filter_activate");
-	tf->isDisabled = false;
+	tf->isActive = true;
+	notify_tesseract_thread(tf);
 }
 
 void ocr_filter_deactivate(void *data)
 {
 	struct filter_data *tf = reinterpret_cast<filter_data *>(data);
 	obs_log(LOG_INFO, "ocr_filter_deactivate");
-	tf->isDisabled = true;
+	tf->isActive = false;
+	notify_tesseract_thread(tf);
+}
+
+void ocr_filter_show(void *data)
+{
+	struct filter_data *tf = reinterpret_cast<filter_data *>(data);
+	obs_log(LOG_INFO, "ocr_filter_show");
+	tf->isShowing = true;
+	notify_tesseract_thread(tf);
+}
+
+void ocr_filter_hide(void *data)
+{
+	struct filter_data *tf = reinterpret_cast<filter_data *>(data);
+	obs_log(LOG_INFO, "ocr_filter_hide");
+	tf->isShowing = false;
+	notify_tesseract_thread(tf);
 }
 
 /**                   FILTER CORE                     */
@@ -100,6 +95,7 @@ void *ocr_filter_create(obs_data_t *settings, obs_source_t *source)
 
 	tf->source = source;
 	tf->unique_id = obs_source_get_uuid(source);
+	tf->trace_id = trace_register_filter(obs_source_get_name(source));
 	tf->texrender = gs_texrender_create(GS_BGRA, GS_ZS_NONE);
 	tf->output_source_name = bstrdup(obs_data_get_string(settings, "text_sources"));
 	tf->output_source = nullptr;
@@ -109,8 +105,6 @@ void *ocr_filter_create(obs_data_t *settings, obs_source_t *source)
 	// get the models folder path from the module
 	tf->tesseractTraineddataFilepath = obs_module_file("tessdata");
 
-	tf->tesseract_model = nullptr;
-
 	obs_enter_graphics();
 	char *error;
 	tf->effect = gs_effect_create_from_file(obs_module_file("preview.effect"), &error);
@@ -131,6 +125,21 @@ void *ocr_filter_create(obs_data_t *settings, obs_source_t *source)
 
 	signal_handler_connect(sh_filter, "enable", enable_callback, tf);
 
+	// push results to scripts and plugins, with procs to fetch the latest one or trigger one
+	signal_handler_add(sh_filter, "void ocr_result(ptr source, string text, int confidence, "
+				      "string boxes, int frame_timestamp, int sequence)");
+	proc_handler_t *ph_filter = obs_source_get_proc_handler(tf->source);
+	proc_handler_add(ph_filter,
+			 "void get_last_ocr_result(out string text, out int confidence, "
+			 "out string boxes, out int frame_timestamp, out int sequence)",
+			 get_last_ocr_result_proc, tf);
+	proc_handler_add(ph_filter, "void trigger_ocr()", trigger_ocr_proc, tf);
+	proc_handler_add(ph_filter, "void dump_trace(out string path)", dump_trace_proc, tf);
+	proc_handler_add(ph_filter, "void model_report(out string report)", model_report_proc, tf);
+
+	// the engine is loaded by the worker itself, from the first settings snapshot
+	start_tesseract_thread(tf);
+
 	return tf;
 }
 
@@ -155,18 +164,18 @@ void ocr_filter_destroy(void *data)
 		}
 		obs_leave_graphics();
 
+		stop_auto_tuner(tf);
 		stop_and_join_tesseract_thread(tf);
 
 		cleanup_config_files(tf->unique_id);
 
+		if (get_ocr_settings(tf)->enable_tracing) {
+			trace_dump_to_config_folder();
+		}
+
 		if (tf->tesseractTraineddataFilepath != nullptr) {
 			bfree(tf->tesseractTraineddataFilepath);
 		}
-		if (tf->tesseract_model != nullptr) {
-			tf->tesseract_model->End();
-			delete tf->tesseract_model;
-			tf->tesseract_model = nullptr;
-		}
 		if (tf->output_source_mutex) {
 			delete tf->output_source_mutex;
 			tf->output_source_mutex = nullptr;
@@ -183,15 +192,23 @@ void ocr_filter_video_render(void *data, gs_effect_t *_effect)
 
 	struct filter_data *tf = reinterpret_cast<filter_data *>(data);
 
-	if (tf->isDisabled) {
+	if (is_filter_idle(tf)) {
 		if (tf->source) {
 			obs_source_skip_video_filter(tf->source);
 		}
 		return;
 	}
 
+	// the render thread is shared, so every filter sets whether its capture is traced
+	trace_set_thread_filter(get_ocr_settings(tf)->enable_tracing ? tf->trace_id : 0,
+				"video render");
+
+	// only read back and convert a frame when the worker is about to process one, not every
+	// rendered frame
 	uint32_t width, height;
-	if (!getRGBAFromStageSurface(tf, width, height)) {
+	if (tf->frameRequested.exchange(false) && !getRGBAFromStageSurface(tf, width, height)) {
+		// try again with the next frame
+		tf->frameRequested = true;
 		if (tf->source) {
 			obs_source_skip_video_filter(tf->source);
 		}
@@ -199,7 +216,7 @@ void ocr_filter_video_render(void *data, gs_effect_t *_effect)
 	}
 
 	// if preview binarization is enabled, render the binarized image
-	if (tf->previewBinarization) {
+	if (get_ocr_settings(tf)->previewBinarization) {
 		gs_texture_t *tex = nullptr;
 		{
 			// lock the outputPreviewBGRALock mutex
@@ -15,6 +15,8 @@ obs_properties_t *ocr_filter_properties(void *data);
 void ocr_filter_update(void *data, obs_data_t *settings);
 void ocr_filter_activate(void *data);
 void ocr_filter_deactivate(void *data);
+void ocr_filter_show(void *data);
+void ocr_filter_hide(void *data);
 void ocr_filter_video_tick(void *data, float seconds);
 void ocr_filter_video_render(void *data, gs_effect_t *_effect);
 
@@ -0,0 +1,105 @@
+#ifndef OCR_RESULT_RING_H
+#define OCR_RESULT_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+  * @brief Layout of the shared-memory ring the filter publishes its results to, shared by the
+  * plugin and the reader library in reader/.
+  *
+  * One writer (the filter's worker thread), any number of readers. Every record carries its
+  * own sequence lock: the writer sets it to 2 * sequence - 1 (odd) before writing the record and
+  * to 2 * sequence after, then publishes the sequence in the header. A reader copies the record
+  * and accepts it only if the lock was 2 * sequence before and after the copy.
+*/
+
+constexpr uint32_t OCR_RING_MAGIC = 0x3152434f; // "OCR1"
+constexpr uint32_t OCR_RING_VERSION = 1;
+constexpr uint32_t OCR_RING_CAPACITY = 64;
+constexpr uint32_t OCR_RING_MAX_BOXES = 64;
+constexpr uint32_t OCR_RING_TEXT_SIZE = 2048;
+
+struct ocr_ring_box {
+	int32_t x;
+	int32_t y;
+	int32_t width;
+	int32_t height;
+};
+
+struct ocr_ring_record {
+	std::atomic<uint64_t> lock;
+	uint64_t sequence;
+	// OBS video timestamp of the frame, and the time the result was published, both on the
+	// OBS clock (monotonic)
+	uint64_t frame_timestamp_ns;
+	uint64_t publish_timestamp_ns;
+	int32_t confidence;
+	uint32_t text_length;
+	uint32_t box_count;
+	uint32_t reserved;
+	ocr_ring_box boxes[OCR_RING_MAX_BOXES];
+	// UTF-8, NUL terminated, truncated to OCR_RING_TEXT_SIZE - 1 bytes
+	char text[OCR_RING_TEXT_SIZE];
+};
+
+struct ocr_ring_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t capacity;
+	uint32_t record_size;
+	// sequence of the latest complete record, 0 before the first one
+	std::atomic<uint64_t> write_sequence;
+	uint8_t reserved[40];
+	ocr_ring_record records[OCR_RING_CAPACITY];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+	      "the ring needs lock-free 64-bit atomics to be shared between processes");
+
+/**
+  * @brief A name that fits in max_length characters: the name itself if it's short enough,
+  * otherwise its 64-bit FNV-1a hash in hex
+*/
+inline std::string ocr_ring_short_name(const std::string &name, size_t max_length)
+{
+	if (name.size() <= max_length) {
+		return name;
+	}
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (const char c : name) {
+		hash = (hash ^ (uint8_t)c) * 0x100000001b3ULL;
+	}
+	static const char digits[] = "0123456789abcdef";
+	std::string hex(16, '0');
+	for (int i = 15; i >= 0; i--, hash >>= 4) {
+		hex[i] = digits[hash & 0xf];
+	}
+	return hex;
+}
+
+/**
+  * @brief Name of the shared memory object for a publisher name
+*/
+inline std::string ocr_ring_shm_name(const std::string &name)
+{
+#ifdef _WIN32
+	return "Local\\obs-ocr-" + name;
+#else
+	// macOS allows 31 characters (PSHMNAMLEN) in shm_open names
+	return "/obs-ocr-" + ocr_ring_short_name(name, 22);
+#endif
+}
+
+/**
+  * @brief Path of the Unix domain socket for a publisher name
+*/
+inline std::string ocr_ring_socket_path(const std::string &name)
+{
+	// sun_path holds 104 bytes on macOS
+	return "/tmp/obs-ocr-" + ocr_ring_short_name(name, 80) + ".sock";
+}
+
+#endif /* OCR_RESULT_RING_H */
@@ -0,0 +1,86 @@
+#include "ocr-settings.h"
+#include "seven-segment.h"
+#include "text-utils.h"
+
+void read_ocr_settings(obs_data_t *settings, ocr_settings &snapshot)
+{
+	snapshot.ocr_engine = (int)obs_data_get_int(settings, "ocr_engine");
+	snapshot.sevenSegmentCells =
+		parse_seven_segment_cells(obs_data_get_string(settings, "seven_segment_cells"));
+	snapshot.crnn_model = obs_data_get_string(settings, "crnn_model");
+	snapshot.language = obs_data_get_string(settings, "language");
+	snapshot.auto_languages = obs_data_get_string(settings, "auto_languages");
+	snapshot.model_variant = obs_data_get_string(settings, "model_variant");
+	snapshot.user_patterns = obs_data_get_string(settings, "user_patterns");
+	snapshot.pageSegmentationMode =
+		(int)obs_data_get_int(settings, "page_segmentation_mode");
+	snapshot.char_whitelist = obs_data_get_string(settings, "char_whitelist");
+	snapshot.conf_threshold = (int)obs_data_get_int(settings, "conf_threshold");
+
+	preprocessing_params &params = snapshot.preprocessing;
+	params.binarizationMode = (int)obs_data_get_int(settings, "binarization_mode");
+	params.binarizationThreshold = (int)obs_data_get_int(settings, "binarization_threshold");
+	params.binarizationBlockSize = (int)obs_data_get_int(settings, "binarization_block_size");
+	params.dilationIterations = (int)obs_data_get_int(settings, "dilation_iterations");
+	params.erosionIterations = (int)obs_data_get_int(settings, "erosion_iterations");
+	params.denoiseKernelSize = (int)obs_data_get_int(settings, "denoise_kernel_size");
+	params.rescaleTargetSize = (int)obs_data_get_int(settings, "rescale_target_size");
+
+	// an empty stage list keeps the fixed order of the binarization/dilation/rescale options
+	const std::string preprocessing_stages =
+		strip(obs_data_get_string(settings, "preprocessing_stages"));
+	snapshot.preprocessingStages =
+		preprocessing_stages.empty()
+			? legacy_preprocessing_stages(params.binarizationMode,
+						      params.dilationIterations,
+						      obs_data_get_bool(settings, "rescale_image"))
+			: parse_preprocessing_stages(preprocessing_stages);
+	snapshot.previewBinarization = obs_data_get_bool(settings, "preview_binarization");
+	snapshot.textDetectionPrepass = obs_data_get_bool(settings, "text_detection_prepass");
+	snapshot.layout_cache = obs_data_get_bool(settings, "layout_cache");
+	snapshot.layout_refresh_frames = (int)obs_data_get_int(settings, "layout_refresh_frames");
+
+	// set the crop region from the properties
+	cv::Rect2i &crop = snapshot.cropRegionRelative;
+	crop.x = (int)obs_data_get_int(settings, "crop_left");
+	crop.y = (int)obs_data_get_int(settings, "crop_top");
+	crop.width = -(int)obs_data_get_int(settings, "crop_right") - crop.x;
+	crop.height = -(int)obs_data_get_int(settings, "crop_bottom") - crop.y;
+	snapshot.auto_roi = obs_data_get_bool(settings, "auto_roi");
+	snapshot.auto_roi_margin = (int)obs_data_get_int(settings, "auto_roi_margin");
+	snapshot.auto_roi_refresh_frames = (int)obs_data_get_int(settings, "auto_roi_refresh");
+	snapshot.auto_rescale = obs_data_get_bool(settings, "rescale_auto");
+	snapshot.recognition_deadline_ms =
+		(uint32_t)obs_data_get_int(settings, "recognition_deadline");
+	snapshot.deadline_retry = obs_data_get_bool(settings, "deadline_retry");
+
+	snapshot.postprocess_replacements =
+		obs_data_get_string(settings, "postprocess_replacements");
+	snapshot.postprocess_rules = obs_data_get_string(settings, "postprocess_rules");
+	snapshot.validation_pattern = obs_data_get_string(settings, "validation_pattern");
+	snapshot.enable_smoothing = obs_data_get_bool(settings, "enable_smoothing");
+	snapshot.word_length = obs_data_get_int(settings, "word_length");
+	snapshot.window_size = obs_data_get_int(settings, "window_size");
+
+	snapshot.update_timer_ms = (uint32_t)obs_data_get_int(settings, "update_timer");
+	snapshot.update_on_change = obs_data_get_bool(settings, "update_on_change");
+	snapshot.update_on_change_threshold =
+		(int)obs_data_get_int(settings, "update_on_change_threshold");
+
+	snapshot.output_format_template = obs_data_get_string(settings, "output_formatting");
+	snapshot.output_image_option = (int)obs_data_get_int(settings, "image_output_option");
+	snapshot.output_file_append = obs_data_get_bool(settings, "output_file_append");
+	snapshot.output_flatten = obs_data_get_bool(settings, "output_flatten");
+	snapshot.output_targets = obs_data_get_string(settings, "output_targets");
+	snapshot.sync_output = obs_data_get_bool(settings, "sync_output");
+	snapshot.sync_latency_ms = (uint32_t)obs_data_get_int(settings, "sync_latency_ms");
+	snapshot.publish_results = obs_data_get_bool(settings, "publish_results");
+	snapshot.publish_name = obs_data_get_string(settings, "publish_name");
+	snapshot.publish_socket = obs_data_get_bool(settings, "publish_socket");
+	snapshot.enable_tracing = obs_data_get_bool(settings, "enable_tracing");
+	snapshot.record_frames = obs_data_get_bool(settings, "record_frames");
+	if (snapshot.record_frames) {
+		// with the defaults, so that a replay doesn't depend on the plugin version's defaults
+		snapshot.settings_json = obs_data_get_json_with_defaults(settings);
+	}
+}
@@ -0,0 +1,109 @@
+#ifndef OCR_SETTINGS_H
+#define OCR_SETTINGS_H
+
+#include <obs.h>
+
+#include <opencv2/core/mat.hpp>
+
+#include "consts.h"
+#include "preprocessing-pipeline.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+  * @brief An immutable snapshot of the filter settings used by the OCR worker.
+  *
+  * A new snapshot is built on every settings update and published atomically, the worker picks
+  * up the latest one at the start of each frame and compares it with the one it last applied
+  * to decide which parts of the engine need to be reconfigured.
+*/
+struct ocr_settings {
+	// increases with every published snapshot
+	uint64_t version = 0;
+
+	int ocr_engine = 0;
+	// seven-segment digit cells in cropped image coordinates, empty to detect them
+	std::vector<cv::Rect> sevenSegmentCells;
+	// CRNN model file name in the tessdata folder, without the .onnx extension
+	std::string crnn_model;
+
+	std::string language;
+	// candidates when language is AUTO_LANGUAGE, comma separated
+	std::string auto_languages;
+	// MODEL_VARIANT_BEST, _FAST or _INT
+	std::string model_variant = MODEL_VARIANT_BEST;
+	std::string user_patterns;
+	int pageSegmentationMode = 3;
+	std::string char_whitelist;
+	int conf_threshold = 50;
+
+	std::vector<PreprocessingStage> preprocessingStages;
+	preprocessing_params preprocessing;
+	bool previewBinarization = false;
+	bool textDetectionPrepass = false;
+	// reuse the text lines of a full layout analysis for the next frames
+	bool layout_cache = false;
+	int layout_refresh_frames = 30;
+	cv::Rect2i cropRegionRelative;
+	// follow the text inside the crop, see process_frame
+	bool auto_roi = false;
+	int auto_roi_margin = 20;
+	int auto_roi_refresh_frames = 10;
+
+	// scale the resize stages so that the text is preprocessing.rescaleTargetSize pixels high,
+	// rather than the whole crop
+	bool auto_rescale = false;
+
+	// abandon a recognition after this long, 0 for no limit, and retry it at half the size
+	uint32_t recognition_deadline_ms = 0;
+	bool deadline_retry = true;
+
+	// post-processing, see PostProcessor
+	std::string postprocess_replacements;
+	std::string postprocess_rules;
+	std::string validation_pattern;
+
+	bool enable_smoothing = false;
+	size_t word_length = 0;
+	size_t window_size = 0;
+
+	uint32_t update_timer_ms = 1000;
+	bool update_on_change = false;
+	int update_on_change_threshold = 0;
+
+	// hold every output until its frame is this old, so that overlays line up with the video
+	bool sync_output = false;
+	uint32_t sync_latency_ms = 0;
+
+	// publish results to the shared-memory ring and optionally the Unix socket for this name
+	bool publish_results = false;
+	std::string publish_name;
+	bool publish_socket = false;
+
+	// record the pipeline stages for trace_dump
+	bool enable_tracing = false;
+	// write the frames the worker processes to a recording, see frame-recording.h
+	bool record_frames = false;
+	// the filter settings as JSON, only filled while recording
+	std::string settings_json;
+
+	std::string output_source_name;
+	std::string output_image_source_name;
+	std::string output_format_template;
+	int output_image_option = 0;
+	std::string output_file_path;
+	bool output_file_append = false;
+	// extra outputs, one per line, see parse_output_targets
+	std::string output_targets;
+	bool output_flatten = false;
+};
+
+/**
+  * @brief Fill a snapshot from the filter settings, all but the version and the output source
+  * names, which the filter sets
+*/
+void read_ocr_settings(obs_data_t *settings, ocr_settings &snapshot);
+
+#endif /* OCR_SETTINGS_H */
@@ -0,0 +1,232 @@
+#include "output-targets.h"
+#include "obs-utils.h"
+#include "plugin-support.h"
+#include "text-utils.h"
+
+#include <obs-module.h>
+#include <util/platform.h>
+
+#include <inja/inja.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+const char *const FILE_TARGET_PREFIX = "file:";
+const char *const VALIDATE_OPTION = "validate=";
+
+/**
+  * @brief Position of the '[' that opens the options at the end of a target, skipping the
+  * balanced brackets of a validation pattern
+  * @return std::string::npos if the target has no options
+*/
+size_t find_options_bracket(const std::string &target)
+{
+	if (target.empty() || target.back() != ']') {
+		return std::string::npos;
+	}
+	int depth = 0;
+	for (size_t i = target.size(); i-- > 0;) {
+		if (i > 0 && target[i - 1] == '\\') {
+			// an escaped bracket in the pattern
+			continue;
+		}
+		if (target[i] == ']') {
+			depth++;
+		} else if (target[i] == '[' && --depth == 0) {
+			return i;
+		}
+	}
+	return std::string::npos;
+}
+
+void parse_options(const std::string &options, output_target_spec &target)
+{
+	std::stringstream ss(options);
+	std::string option;
+	while (std::getline(ss, option, ',')) {
+		option = strip(option);
+		if (option.rfind(VALIDATE_OPTION, 0) == 0) {
+			// the pattern may contain commas, it takes the rest of the options
+			std::string rest;
+			std::getline(ss, rest, '\0');
+			if (!rest.empty()) {
+				option += "," + rest;
+			}
+			target.validationPattern = strip(option.substr(strlen(VALIDATE_OPTION)));
+			return;
+		} else if (option == "flatten") {
+			target.flatten = true;
+		} else if (option == "append") {
+			target.append = true;
+		} else if (option == "changes") {
+			target.onlyChanges = true;
+		} else if (option.rfind("every ", 0) == 0) {
+			target.minIntervalMs = (uint32_t)std::max(0, atoi(option.c_str() + 6));
+		} else if (!option.empty()) {
+			obs_log(LOG_WARNING, "Unknown output option '%s' for '%s'", option.c_str(),
+				target.target.c_str());
+		}
+	}
+}
+
+} // namespace
+
+std::vector<output_target_spec> parse_output_targets(const std::string &spec)
+{
+	std::vector<output_target_spec> parsed;
+	std::stringstream ss(spec);
+	std::string line;
+	while (std::getline(ss, line)) {
+		const size_t arrow = line.find("=>");
+		std::string target = strip(line.substr(0, arrow));
+		if (target.empty() || target[0] == '#') {
+			continue;
+		}
+		output_target_spec entry;
+		if (arrow != std::string::npos && !strip(line.substr(arrow + 2)).empty()) {
+			entry.templateText = strip(line.substr(arrow + 2));
+		}
+		// options in brackets at the end of the target
+		const size_t bracket = find_options_bracket(target);
+		if (bracket != std::string::npos) {
+			const std::string options =
+				target.substr(bracket + 1, target.size() - bracket - 2);
+			target = strip(target.substr(0, bracket));
+			entry.target = target;
+			parse_options(options, entry);
+		}
+		if (target.rfind(FILE_TARGET_PREFIX, 0) == 0) {
+			entry.isFile = true;
+			target = strip(target.substr(strlen(FILE_TARGET_PREFIX)));
+		}
+		entry.target = target;
+		if (!entry.target.empty()) {
+			parsed.push_back(entry);
+		}
+	}
+	return parsed;
+}
+
+OutputFanOut::~OutputFanOut()
+{
+	release_sources();
+}
+
+void OutputFanOut::release_sources()
+{
+	for (Target &target : targets) {
+		if (target.source != nullptr) {
+			obs_weak_source_release(target.source);
+			target.source = nullptr;
+		}
+	}
+}
+
+void OutputFanOut::configure(const std::string &spec)
+{
+	if (spec == targetsSpec) {
+		return;
+	}
+	targetsSpec = spec;
+	release_sources();
+	targets.clear();
+	for (const output_target_spec &parsed : parse_output_targets(spec)) {
+		Target target;
+		target.spec = parsed;
+		if (!parsed.validationPattern.empty()) {
+			try {
+				target.validation = std::regex(parsed.validationPattern);
+				target.hasValidation = true;
+			} catch (const std::regex_error &e) {
+				// dropping every result would look like the target stopped working
+				obs_log(LOG_WARNING,
+					"Invalid validation pattern '%s' for '%s', not "
+					"validating: %s",
+					parsed.validationPattern.c_str(), parsed.target.c_str(),
+					e.what());
+			}
+		}
+		targets.push_back(target);
+	}
+}
+
+void OutputFanOut::send(inja::Environment &env, const std::string &text,
+			uint64_t frameTimestampNs)
+{
+	const uint64_t now = os_gettime_ns();
+	for (Target &target : targets) {
+		if (target.spec.minIntervalMs > 0 && target.lastSentNs != 0 &&
+		    now - target.lastSentNs < (uint64_t)target.spec.minIntervalMs * 1000000) {
+			continue;
+		}
+		if (target.hasValidation && !std::regex_match(text, target.validation)) {
+			continue;
+		}
+		std::string formatted;
+		try {
+			formatted = format_text_with_template(env, text, target.spec.templateText,
+							      frameTimestampNs);
+		} catch (const std::exception &e) {
+			obs_log(LOG_WARNING, "Output template for '%s' failed: %s",
+				target.spec.target.c_str(), e.what());
+			continue;
+		}
+		if (target.spec.flatten) {
+			flatten_text(formatted);
+		}
+		if (target.spec.onlyChanges && formatted == target.lastText) {
+			continue;
+		}
+		write(target, formatted);
+		target.lastText = formatted;
+		target.lastSentNs = now;
+	}
+}
+
+void OutputFanOut::write(Target &target, const std::string &text)
+{
+	if (target.spec.isFile) {
+		std::ofstream file(target.spec.target,
+				   target.spec.append ? std::ios_base::app : std::ios_base::trunc);
+		if (!file.is_open()) {
+			obs_log(LOG_ERROR, "failed to open file %s", target.spec.target.c_str());
+			return;
+		}
+		file << text;
+		if (target.spec.append) {
+			file << "\n";
+		}
+		return;
+	}
+
+	obs_source_t *source =
+		target.source != nullptr ? obs_weak_source_get_source(target.source) : nullptr;
+	if (source == nullptr) {
+		// not created yet, or removed or renamed since, look it up again by name
+		if (target.source != nullptr) {
+			obs_weak_source_release(target.source);
+			target.source = nullptr;
+		}
+		source = obs_get_source_by_name(target.spec.target.c_str());
+		if (source == nullptr) {
+			if (!target.warned) {
+				obs_log(LOG_WARNING, "Output source '%s' not found",
+					target.spec.target.c_str());
+				target.warned = true;
+			}
+			return;
+		}
+		target.source = obs_source_get_weak_source(source);
+		target.warned = false;
+	}
+	obs_data_t *settings = obs_source_get_settings(source);
+	obs_data_set_string(settings, "text", text.c_str());
+	obs_source_update(source, settings);
+	obs_data_release(settings);
+	obs_source_release(source);
+}
@@ -0,0 +1,84 @@
+#ifndef OUTPUT_TARGETS_H
+#define OUTPUT_TARGETS_H
+
+#include <obs.h>
+
+#include <cstdint>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace inja {
+class Environment;
+}
+
+/**
+  * @brief One extra output of a filter, parsed from a line like
+  * "Lower Third [flatten, changes] => {{output}}",
+  * "file:/home/me/ocr.log [append, every 5000] => [{{frame_unix_ms}}] {{output}}" or
+  * "Clock [changes, validate=\d{1,2}:\d\d] => {{output}}"
+*/
+struct output_target_spec {
+	// text source name, or the file path for file targets
+	std::string target;
+	bool isFile = false;
+	// inja template, "{{output}}" when the line has none
+	std::string templateText = "{{output}}";
+	bool flatten = false;
+	// file targets: add a line instead of replacing the content
+	bool append = false;
+	// only send when the formatted text differs from the last one sent to this target
+	bool onlyChanges = false;
+	// at most one update per interval, 0 for every result
+	uint32_t minIntervalMs = 0;
+	// regex the whole recognized text has to match to be sent to this target, empty for all.
+	// The last option, it takes the rest of the brackets, commas included
+	std::string validationPattern;
+};
+
+/**
+  * @brief Parse one target per line, empty lines and lines starting with # are skipped.
+  * Invalid options are logged and ignored.
+*/
+std::vector<output_target_spec> parse_output_targets(const std::string &spec);
+
+/**
+  * @brief Sends every result to a list of targets, each with its own template, flatten option
+  * and update policy. Only used by the worker thread.
+*/
+class OutputFanOut {
+public:
+	~OutputFanOut();
+
+	/**
+	  * @brief Set the targets, the per-target state is kept while the spec doesn't change.
+	  * Validation patterns are compiled here, invalid ones are logged and not checked.
+	*/
+	void configure(const std::string &spec);
+
+	/**
+	  * @brief Send a result to every target whose validation pattern it matches
+	*/
+	void send(inja::Environment &env, const std::string &text, uint64_t frameTimestampNs);
+
+	bool empty() const { return targets.empty(); }
+
+private:
+	struct Target {
+		output_target_spec spec;
+		obs_weak_source_t *source = nullptr;
+		bool hasValidation = false;
+		std::regex validation;
+		bool warned = false;
+		std::string lastText;
+		uint64_t lastSentNs = 0;
+	};
+
+	void release_sources();
+	void write(Target &target, const std::string &text);
+
+	std::string targetsSpec;
+	std::vector<Target> targets;
+};
+
+#endif /* OUTPUT_TARGETS_H */
@@ -0,0 +1,183 @@
+#include "pipeline-trace.h"
+#include "obs-utils.h"
+#include "plugin-support.h"
+
+#include <obs-module.h>
+#include <util/platform.h>
+
+#include <inja/inja.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+// per thread, about 1.5 MB once a thread records its first event
+constexpr uint64_t TRACE_BUFFER_CAPACITY = 1 << 16;
+
+struct trace_event {
+	const char *name;
+	uint32_t filterId;
+	uint64_t startNs;
+	uint64_t durationNs;
+};
+
+/**
+  * @brief Ring of the latest events of one thread. Only the owning thread writes, a dump copies
+  * the entries below written and drops the ones that may have been overwritten meanwhile.
+*/
+struct thread_trace_buffer {
+	uint32_t tid = 0;
+	const char *threadName = nullptr;
+	std::vector<trace_event> events = std::vector<trace_event>(TRACE_BUFFER_CAPACITY);
+	std::atomic<uint64_t> written{0};
+};
+
+std::mutex registry_mutex;
+// kept after their thread exited, so that a dump still shows what a stopped worker did
+std::vector<std::shared_ptr<thread_trace_buffer>> thread_buffers;
+std::map<uint32_t, std::string> filter_names;
+uint32_t next_filter_id = 1;
+
+thread_local uint32_t current_filter = 0;
+thread_local const char *current_thread_name = "thread";
+thread_local std::shared_ptr<thread_trace_buffer> current_buffer;
+
+thread_trace_buffer &get_thread_buffer()
+{
+	if (!current_buffer) {
+		auto buffer = std::make_shared<thread_trace_buffer>();
+		buffer->threadName = current_thread_name;
+		std::lock_guard<std::mutex> lock(registry_mutex);
+		buffer->tid = (uint32_t)thread_buffers.size() + 1;
+		thread_buffers.push_back(buffer);
+		current_buffer = buffer;
+	}
+	return *current_buffer;
+}
+
+std::vector<trace_event> copy_events(const thread_trace_buffer &buffer)
+{
+	const uint64_t end = buffer.written.load(std::memory_order_acquire);
+	const uint64_t begin = end > TRACE_BUFFER_CAPACITY ? end - TRACE_BUFFER_CAPACITY : 0;
+	std::vector<trace_event> events;
+	events.reserve((size_t)(end - begin));
+	for (uint64_t i = begin; i < end; i++) {
+		events.push_back(buffer.events[(size_t)(i % TRACE_BUFFER_CAPACITY)]);
+	}
+	// the owner kept writing during the copy, the slot it writes next may be torn too
+	const uint64_t endAfter = buffer.written.load(std::memory_order_acquire);
+	if (endAfter + 1 > TRACE_BUFFER_CAPACITY) {
+		const uint64_t firstValid = endAfter + 1 - TRACE_BUFFER_CAPACITY;
+		if (firstValid > begin) {
+			events.erase(events.begin(),
+				     events.begin() + (ptrdiff_t)std::min<uint64_t>(
+							      firstValid - begin, events.size()));
+		}
+	}
+	return events;
+}
+
+} // namespace
+
+uint32_t trace_register_filter(const std::string &name)
+{
+	std::lock_guard<std::mutex> lock(registry_mutex);
+	const uint32_t id = next_filter_id++;
+	filter_names[id] = name;
+	return id;
+}
+
+void trace_set_thread_filter(uint32_t filterId, const char *threadName)
+{
+	current_filter = filterId;
+	current_thread_name = threadName;
+}
+
+TraceScope::TraceScope(const char *name) : eventName(name), filterId(current_filter)
+{
+	if (filterId != 0) {
+		startNs = os_gettime_ns();
+	}
+}
+
+TraceScope::~TraceScope()
+{
+	if (filterId == 0) {
+		return;
+	}
+	thread_trace_buffer &buffer = get_thread_buffer();
+	const uint64_t index = buffer.written.load(std::memory_order_relaxed);
+	buffer.events[(size_t)(index % TRACE_BUFFER_CAPACITY)] = {eventName, filterId, startNs,
+								  os_gettime_ns() - startNs};
+	buffer.written.store(index + 1, std::memory_order_release);
+}
+
+bool trace_dump(const std::string &path)
+{
+	std::vector<std::shared_ptr<thread_trace_buffer>> buffers;
+	std::map<uint32_t, std::string> names;
+	{
+		std::lock_guard<std::mutex> lock(registry_mutex);
+		buffers = thread_buffers;
+		names = filter_names;
+	}
+
+	nlohmann::json events = nlohmann::json::array();
+	size_t count = 0;
+	for (const std::shared_ptr<thread_trace_buffer> &buffer : buffers) {
+		nlohmann::json threadName;
+		threadName["name"] = "thread_name";
+		threadName["ph"] = "M";
+		threadName["pid"] = 1;
+		threadName["tid"] = buffer->tid;
+		threadName["args"]["name"] = buffer->threadName;
+		events.push_back(threadName);
+
+		for (const trace_event &e : copy_events(*buffer)) {
+			nlohmann::json event;
+			event["name"] = e.name;
+			event["cat"] = "ocr";
+			// complete events, a begin and end pair in one entry
+			event["ph"] = "X";
+			event["pid"] = 1;
+			event["tid"] = buffer->tid;
+			event["ts"] = (double)e.startNs / 1e3;
+			event["dur"] = (double)e.durationNs / 1e3;
+			event["args"]["filter"] = names[e.filterId];
+			events.push_back(event);
+			count++;
+		}
+	}
+
+	nlohmann::json trace;
+	trace["traceEvents"] = events;
+	trace["displayTimeUnit"] = "ms";
+	std::ofstream out(path);
+	if (!out) {
+		obs_log(LOG_ERROR, "Failed to write the trace to %s", path.c_str());
+		return false;
+	}
+	out << trace.dump();
+	obs_log(LOG_INFO, "Wrote %zu trace events of %zu threads to %s", count, buffers.size(),
+		path.c_str());
+	return true;
+}
+
+std::string trace_dump_to_config_folder()
+{
+	check_plugin_config_folder_exists();
+	char *filename =
+		os_generate_formatted_filename("json", true, "trace-%CCYY%MM%DD-%hh%mm%ss");
+	char *path = obs_module_config_path(filename);
+	const std::string result = path;
+	bfree(path);
+	bfree(filename);
+	return trace_dump(result) ? result : "";
+}
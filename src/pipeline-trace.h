@@ -0,0 +1,59 @@
+#ifndef PIPELINE_TRACE_H
+#define PIPELINE_TRACE_H
+
+#include <cstdint>
+#include <string>
+
+/**
+  * @brief Optional tracing of the pipeline stages, exported as Chrome trace JSON.
+  *
+  * Every thread records into its own fixed-size ring of events, without locks, once it was
+  * told which filter it works for with trace_set_thread_filter. The dump can be opened in
+  * chrome://tracing or https://ui.perfetto.dev to see the render thread and the OCR workers
+  * of all filters on one timeline.
+*/
+
+/**
+  * @brief Register a filter, its events are labelled with name in the trace
+  * @return id for trace_set_thread_filter, never 0
+*/
+uint32_t trace_register_filter(const std::string &name);
+
+/**
+  * @brief Set the filter the following events of the calling thread belong to
+  * @param filterId id from trace_register_filter, or 0 to stop recording on this thread
+  * @param threadName shown for the thread in the trace, has to be a string literal
+*/
+void trace_set_thread_filter(uint32_t filterId, const char *threadName);
+
+/**
+  * @brief Write the recorded events of all threads to path as Chrome trace JSON
+*/
+bool trace_dump(const std::string &path);
+
+/**
+  * @brief Write the recorded events to a timestamped file in the module config folder
+  * @return the path of the file, empty if it couldn't be written
+*/
+std::string trace_dump_to_config_folder();
+
+/**
+  * @brief Records the time between its construction and destruction as one trace event
+*/
+class TraceScope {
+public:
+	/**
+	  * @param name has to be a string literal, it is only stored as a pointer
+	*/
+	explicit TraceScope(const char *name);
+	~TraceScope();
+	TraceScope(const TraceScope &) = delete;
+	TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+	const char *eventName;
+	uint32_t filterId;
+	uint64_t startNs = 0;
+};
+
+#endif /* PIPELINE_TRACE_H */
@@ -19,6 +19,9 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #include <obs-module.h>
 #include <plugin-support.h>
 
+#include "cpu-budget.h"
+#include "model-manager.h"
+
 OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE(PLUGIN_NAME, "en-US")
 
@@ -31,6 +34,7 @@ MODULE_EXPORT const char *obs_module_description(void)
 
 bool obs_module_load(void)
 {
+	load_cpu_budget();
 	obs_register_source(&ocr_filter_info);
 	obs_log(LOG_INFO, "OCR plugin loaded successfully (version %s)", PLUGIN_VERSION);
 	return true;
@@ -38,5 +42,6 @@ bool obs_module_load(void)
 
 void obs_module_unload(void)
 {
+	stop_model_manager();
 	obs_log(LOG_INFO, "OCR plugin unloaded");
 }
@@ -0,0 +1,123 @@
+#include "post-processing.h"
+#include "plugin-support.h"
+
+#include <obs-module.h>
+
+#include <sstream>
+
+namespace {
+
+std::string trim(const std::string &str)
+{
+	const size_t start = str.find_first_not_of(" \t\r");
+	if (start == std::string::npos) {
+		return "";
+	}
+	return str.substr(start, str.find_last_not_of(" \t\r") - start + 1);
+}
+
+/**
+  * @brief Parse a table like "O=0, l=1" into (from, to) pairs. A literal comma or equals sign
+  * can't be replaced, use a rule for those.
+*/
+std::vector<std::pair<std::string, std::string>> parse_replacements(const std::string &spec)
+{
+	std::vector<std::pair<std::string, std::string>> parsed;
+	std::stringstream ss(spec);
+	std::string entry;
+	while (std::getline(ss, entry, ',')) {
+		const size_t equals = entry.find('=');
+		const std::string from = trim(entry.substr(0, equals));
+		if (equals == std::string::npos || from.empty()) {
+			if (!trim(entry).empty()) {
+				obs_log(LOG_WARNING, "Invalid replacement '%s', expected from=to",
+					entry.c_str());
+			}
+			continue;
+		}
+		parsed.emplace_back(from, trim(entry.substr(equals + 1)));
+	}
+	return parsed;
+}
+
+} // namespace
+
+void PostProcessor::configure(const std::string &replacements_, const std::string &rules_,
+			      const std::string &validation_)
+{
+	if (replacements_ != replacementsSpec) {
+		replacementsSpec = replacements_;
+		replacements = parse_replacements(replacementsSpec);
+	}
+
+	if (rules_ != rulesSpec) {
+		rulesSpec = rules_;
+		rules.clear();
+		std::stringstream ss(rulesSpec);
+		std::string line;
+		while (std::getline(ss, line)) {
+			const size_t arrow = line.find("=>");
+			const std::string pattern = trim(line.substr(0, arrow));
+			if (pattern.empty() || pattern[0] == '#') {
+				continue;
+			}
+			// no replacement removes the matches
+			const std::string replacement =
+				arrow == std::string::npos ? "" : trim(line.substr(arrow + 2));
+			try {
+				rules.push_back({std::regex(pattern), replacement});
+			} catch (const std::regex_error &e) {
+				obs_log(LOG_WARNING, "Invalid post-processing rule '%s': %s",
+					pattern.c_str(), e.what());
+			}
+		}
+	}
+
+	if (validation_ != validationSpec) {
+		validationSpec = validation_;
+		hasValidation = false;
+		const std::string pattern = trim(validationSpec);
+		if (!pattern.empty()) {
+			try {
+				validation = std::regex(pattern);
+				hasValidation = true;
+			} catch (const std::regex_error &e) {
+				// rejecting every read would look like OCR stopped working
+				obs_log(LOG_WARNING,
+					"Invalid validation pattern '%s', not validating: %s",
+					pattern.c_str(), e.what());
+			}
+		}
+	}
+}
+
+bool PostProcessor::process(std::string &text) const
+{
+	if (!replacements.empty()) {
+		// a single scan, so that swaps like "0=O,O=0" don't undo each other
+		std::string replaced;
+		replaced.reserve(text.size());
+		size_t pos = 0;
+		while (pos < text.size()) {
+			bool matched = false;
+			for (const auto &[from, to] : replacements) {
+				if (text.compare(pos, from.size(), from) == 0) {
+					replaced += to;
+					pos += from.size();
+					matched = true;
+					break;
+				}
+			}
+			if (!matched) {
+				replaced += text[pos++];
+			}
+		}
+		text = std::move(replaced);
+	}
+
+	for (const Rule &rule : rules) {
+		text = std::regex_replace(text, rule.pattern, rule.replacement);
+	}
+
+	return !hasValidation || std::regex_match(text, validation);
+}
@@ -0,0 +1,46 @@
+#ifndef POST_PROCESSING_H
+#define POST_PROCESSING_H
+
+#include <regex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+  * @brief Normalizes and validates recognized text before smoothing and output.
+  *
+  * Runs, in order: a replacement table for common confusions (e.g. "O=0,l=1"), regex rules one
+  * per line as "pattern => replacement", and a validation pattern the whole text has to match.
+  * Everything is compiled in configure(), process() never compiles a regex.
+*/
+class PostProcessor {
+public:
+	/**
+	  * @brief Set the configuration, recompiling only the parts that changed. Invalid
+	  * patterns are logged and skipped.
+	*/
+	void configure(const std::string &replacements, const std::string &rules,
+		       const std::string &validation);
+
+	/**
+	  * @brief Apply the replacements and rules to text in place
+	  * @return false if the result doesn't match the validation pattern
+	*/
+	bool process(std::string &text) const;
+
+private:
+	struct Rule {
+		std::regex pattern;
+		std::string replacement;
+	};
+
+	std::string replacementsSpec;
+	std::string rulesSpec;
+	std::string validationSpec;
+	std::vector<std::pair<std::string, std::string>> replacements;
+	std::vector<Rule> rules;
+	bool hasValidation = false;
+	std::regex validation;
+};
+
+#endif /* POST_PROCESSING_H */
@@ -0,0 +1,506 @@
+#include "preprocessing-pipeline.h"
+#include "plugin-support.h"
+#include "pipeline-trace.h"
+
+#include <obs-module.h>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+namespace {
+
+// fixed-point BGR->gray coefficients, the same ones cv::cvtColor uses
+constexpr int LUMA_SHIFT = 14;
+constexpr int LUMA_B = 1868;
+constexpr int LUMA_G = 9617;
+constexpr int LUMA_R = 4899;
+
+// fixed-point precision of the bilinear resampling weights
+constexpr int RESIZE_BITS = 11;
+constexpr int RESIZE_ONE = 1 << RESIZE_BITS;
+
+template<int CN> inline uchar pixel_luma(const uchar *p)
+{
+	if (CN == 1) {
+		return p[0];
+	}
+	return (uchar)((p[0] * LUMA_B + p[1] * LUMA_G + p[2] * LUMA_R +
+			(1 << (LUMA_SHIFT - 1))) >>
+		       LUMA_SHIFT);
+}
+
+template<int CN> void luma_row(const uchar *src, uchar *dst, int width)
+{
+	for (int x = 0; x < width; x++) {
+		dst[x] = pixel_luma<CN>(src + CN * x);
+	}
+}
+
+template<int CN> void gray_threshold_kernel(const cv::Mat &src, cv::Mat &dst, int threshold)
+{
+	cv::parallel_for_(cv::Range(0, src.rows), [&](const cv::Range &range) {
+		for (int y = range.start; y < range.end; y++) {
+			const uchar *s = src.ptr<uchar>(y);
+			uchar *d = dst.ptr<uchar>(y);
+			for (int x = 0; x < src.cols; x++) {
+				d[x] = pixel_luma<CN>(s + CN * x) > threshold ? 255 : 0;
+			}
+		}
+	});
+}
+
+template<int CN>
+void gray_resize_kernel(const cv::Mat &src, cv::Mat &dst, const std::vector<int> &xOffsets0,
+			const std::vector<int> &xOffsets1, const std::vector<int> &xWeights,
+			int threshold)
+{
+	const double scaleY = (double)src.rows / (double)dst.rows;
+	cv::parallel_for_(cv::Range(0, dst.rows), [&](const cv::Range &range) {
+		// luma of the two source rows of the current output row, reused while upscaling
+		std::vector<uchar> lumaRows(CN == 1 ? 0 : 2 * (size_t)src.cols);
+		int cachedY0 = -1;
+		int cachedY1 = -1;
+		for (int y = range.start; y < range.end; y++) {
+			const double fy = ((double)y + 0.5) * scaleY - 0.5;
+			int y0 = (int)std::floor(fy);
+			int wy = (int)((fy - (double)y0) * RESIZE_ONE + 0.5);
+			if (y0 < 0) {
+				y0 = 0;
+				wy = 0;
+			}
+			if (y0 >= src.rows - 1) {
+				y0 = src.rows - 1;
+				wy = 0;
+			}
+			const int y1 = std::min(y0 + 1, src.rows - 1);
+
+			const uchar *r0;
+			const uchar *r1;
+			if (CN == 1) {
+				r0 = src.ptr<uchar>(y0);
+				r1 = src.ptr<uchar>(y1);
+			} else {
+				if (y0 != cachedY0 || y1 != cachedY1) {
+					luma_row<CN>(src.ptr<uchar>(y0), lumaRows.data(), src.cols);
+					luma_row<CN>(src.ptr<uchar>(y1), lumaRows.data() + src.cols,
+						     src.cols);
+					cachedY0 = y0;
+					cachedY1 = y1;
+				}
+				r0 = lumaRows.data();
+				r1 = lumaRows.data() + src.cols;
+			}
+
+			uchar *d = dst.ptr<uchar>(y);
+			for (int x = 0; x < dst.cols; x++) {
+				const int x0 = xOffsets0[x];
+				const int x1 = xOffsets1[x];
+				const int wx = xWeights[x];
+				const int top = r0[x0] * (RESIZE_ONE - wx) + r0[x1] * wx;
+				const int bottom = r1[x0] * (RESIZE_ONE - wx) + r1[x1] * wx;
+				const int v = (top * (RESIZE_ONE - wy) + bottom * wy +
+					       (1 << (2 * RESIZE_BITS - 1))) >>
+					      (2 * RESIZE_BITS);
+				if (threshold >= 0) {
+					d[x] = v > threshold ? 255 : 0;
+				} else {
+					d[x] = (uchar)v;
+				}
+			}
+		}
+	});
+}
+
+const cv::Mat &to_gray(const cv::Mat &src, cv::Mat &scratch)
+{
+	if (src.channels() == 1) {
+		return src;
+	}
+	cv::cvtColor(src, scratch, src.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+	return scratch;
+}
+
+} // namespace
+
+std::vector<PreprocessingStage> parse_preprocessing_stages(const std::string &spec)
+{
+	std::vector<PreprocessingStage> stages;
+	std::string normalized = spec;
+	std::replace(normalized.begin(), normalized.end(), ',', ' ');
+	std::istringstream stream(normalized);
+	std::string name;
+	while (stream >> name) {
+		std::transform(name.begin(), name.end(), name.begin(),
+			       [](unsigned char c) { return (char)std::tolower(c); });
+		if (name == "gray" || name == "grey") {
+			stages.push_back(PreprocessingStage::Gray);
+		} else if (name == "threshold" || name == "binarize") {
+			stages.push_back(PreprocessingStage::Threshold);
+		} else if (name == "invert") {
+			stages.push_back(PreprocessingStage::Invert);
+		} else if (name == "denoise") {
+			stages.push_back(PreprocessingStage::Denoise);
+		} else if (name == "erode") {
+			stages.push_back(PreprocessingStage::Erode);
+		} else if (name == "dilate") {
+			stages.push_back(PreprocessingStage::Dilate);
+		} else if (name == "resize" || name == "rescale") {
+			stages.push_back(PreprocessingStage::Resize);
+		} else {
+			obs_log(LOG_WARNING, "Unknown preprocessing stage '%s', skipping",
+				name.c_str());
+		}
+	}
+	return stages;
+}
+
+std::vector<PreprocessingStage> legacy_preprocessing_stages(int binarizationMode,
+							    int dilationIterations,
+							    bool rescaleImage)
+{
+	std::vector<PreprocessingStage> stages;
+	if (binarizationMode != 0) {
+		stages.push_back(PreprocessingStage::Threshold);
+	}
+	if (dilationIterations > 0) {
+		stages.push_back(PreprocessingStage::Dilate);
+	}
+	if (rescaleImage) {
+		stages.push_back(PreprocessingStage::Resize);
+	}
+	return stages;
+}
+
+bool frame_changed(const cv::Mat &current, const cv::Mat &previous, int thresholdPercent)
+{
+	const int change_threshold_from_image_area =
+		(int)((float)thresholdPercent / 100.0f * (float)(current.cols * current.rows));
+	// take the absolute difference between the images, convert to gray and count the non-zero
+	// pixels
+	cv::Mat diff;
+	cv::absdiff(current, previous, diff);
+	if (diff.channels() == 4) {
+		cv::cvtColor(diff, diff, cv::COLOR_BGRA2GRAY);
+	}
+	return cv::countNonZero(diff) >= change_threshold_from_image_area;
+}
+
+int estimate_text_height(const cv::Mat &image)
+{
+	cv::Mat grayScratch;
+	cv::Mat binary;
+	cv::threshold(to_gray(image, grayScratch), binary, 0, 255,
+		      cv::THRESH_BINARY | cv::THRESH_OTSU);
+	// the text is the smaller class, whether it is dark on light or light on dark
+	if (cv::countNonZero(binary) * 2 > binary.rows * binary.cols) {
+		cv::bitwise_not(binary, binary);
+	}
+	cv::Mat rowInk;
+	cv::reduce(binary, rowInk, 1, cv::REDUCE_SUM, CV_32S);
+
+	// runs of rows with at least 1% ink are text lines, shorter runs than 4 rows are noise
+	const int minInk = std::max(1, binary.cols / 100) * 255;
+	std::vector<int> lineHeights;
+	int run = 0;
+	for (int y = 0; y <= rowInk.rows; y++) {
+		if (y < rowInk.rows && rowInk.at<int>(y, 0) >= minInk) {
+			run++;
+			continue;
+		}
+		if (run >= 4) {
+			lineHeights.push_back(run);
+		}
+		run = 0;
+	}
+	if (lineHeights.empty()) {
+		return 0;
+	}
+	const auto median = lineHeights.begin() + (ptrdiff_t)(lineHeights.size() / 2);
+	std::nth_element(lineHeights.begin(), median, lineHeights.end());
+	return *median;
+}
+
+void PreprocessingPipeline::configure(const std::vector<PreprocessingStage> &newStages,
+				      const preprocessing_params &newParams)
+{
+	// only a fixed threshold can be fused, so a mode change to or from it needs a new plan
+	const bool recompile = newStages != this->stages ||
+			       (newParams.binarizationMode == 1) !=
+				       (this->params.binarizationMode == 1);
+	this->stages = newStages;
+	this->params = newParams;
+	if (recompile) {
+		compile();
+	}
+}
+
+void PreprocessingPipeline::compile()
+{
+	plan.clear();
+
+	using Stage = PreprocessingStage;
+	const bool fixedThreshold = params.binarizationMode == 1;
+	auto stage_at = [this](size_t i, Stage stage) {
+		return i < stages.size() && stages[i] == stage;
+	};
+	auto add_step = [this](StepKind kind) {
+		plan.push_back(Step{kind, cv::Mat()});
+	};
+
+	// the plan assumes a color input, process() handles gray inputs transparently
+	bool gray = false;
+	for (size_t i = 0; i < stages.size(); i++) {
+		const Stage stage = stages[i];
+		if (!gray && (stage == Stage::Gray || stage == Stage::Resize)) {
+			// gray+resize and resize+gray commute, fuse them with a fixed threshold
+			const Stage other = stage == Stage::Gray ? Stage::Resize : Stage::Gray;
+			if (stage_at(i + 1, other)) {
+				if (fixedThreshold && stage_at(i + 2, Stage::Threshold)) {
+					add_step(StepKind::FusedGrayResizeThreshold);
+					i += 2;
+				} else {
+					add_step(StepKind::FusedGrayResize);
+					i += 1;
+				}
+				gray = true;
+				continue;
+			}
+			if (fixedThreshold && stage_at(i + 1, Stage::Threshold)) {
+				add_step(stage == Stage::Gray ? StepKind::FusedGrayThreshold
+							      : StepKind::FusedGrayResizeThreshold);
+				i += 1;
+				gray = true;
+				continue;
+			}
+		}
+		if (!gray && fixedThreshold && stage == Stage::Threshold) {
+			add_step(StepKind::FusedGrayThreshold);
+			gray = true;
+			continue;
+		}
+		if (gray && fixedThreshold && stage == Stage::Resize &&
+		    stage_at(i + 1, Stage::Threshold)) {
+			add_step(StepKind::FusedGrayResizeThreshold);
+			i += 1;
+			continue;
+		}
+
+		switch (stage) {
+		case Stage::Gray:
+			add_step(StepKind::Gray);
+			gray = true;
+			break;
+		case Stage::Threshold:
+			add_step(StepKind::Threshold);
+			gray = gray || params.binarizationMode != 0;
+			break;
+		case Stage::Invert:
+			add_step(StepKind::Invert);
+			gray = true;
+			break;
+		case Stage::Denoise:
+			add_step(StepKind::Denoise);
+			break;
+		case Stage::Erode:
+			add_step(StepKind::Erode);
+			break;
+		case Stage::Dilate:
+			add_step(StepKind::Dilate);
+			break;
+		case Stage::Resize:
+			add_step(StepKind::Resize);
+			break;
+		}
+	}
+
+	obs_log(LOG_DEBUG, "Preprocessing pipeline compiled: %d stages -> %d steps",
+		(int)stages.size(), (int)plan.size());
+}
+
+cv::Size PreprocessingPipeline::rescaled_size(const cv::Mat &src) const
+{
+	// the auto-scale factor, or scale to height rescaleTargetSize maintaining aspect ratio
+	const double scale = resizeScale > 0.0
+				     ? resizeScale
+				     : (double)params.rescaleTargetSize / (double)src.rows;
+	return cv::Size(std::max(1, (int)std::lround((double)src.cols * scale)),
+			std::max(1, (int)std::lround((double)src.rows * scale)));
+}
+
+void PreprocessingPipeline::fused_gray_resize(const cv::Mat &src, cv::Mat &dst, int threshold)
+{
+	const cv::Size dstSize = rescaled_size(src);
+	dst.create(dstSize, CV_8UC1);
+
+	if (xTableSrcWidth != src.cols || xTableDstWidth != dstSize.width) {
+		xOffsets0.resize((size_t)dstSize.width);
+		xOffsets1.resize((size_t)dstSize.width);
+		xWeights.resize((size_t)dstSize.width);
+		const double scaleX = (double)src.cols / (double)dstSize.width;
+		for (int x = 0; x < dstSize.width; x++) {
+			const double fx = ((double)x + 0.5) * scaleX - 0.5;
+			int x0 = (int)std::floor(fx);
+			int wx = (int)((fx - (double)x0) * RESIZE_ONE + 0.5);
+			if (x0 < 0) {
+				x0 = 0;
+				wx = 0;
+			}
+			if (x0 >= src.cols - 1) {
+				x0 = src.cols - 1;
+				wx = 0;
+			}
+			xOffsets0[(size_t)x] = x0;
+			xOffsets1[(size_t)x] = std::min(x0 + 1, src.cols - 1);
+			xWeights[(size_t)x] = wx;
+		}
+		xTableSrcWidth = src.cols;
+		xTableDstWidth = dstSize.width;
+	}
+
+	switch (src.channels()) {
+	case 1:
+		gray_resize_kernel<1>(src, dst, xOffsets0, xOffsets1, xWeights, threshold);
+		break;
+	case 3:
+		gray_resize_kernel<3>(src, dst, xOffsets0, xOffsets1, xWeights, threshold);
+		break;
+	default:
+		gray_resize_kernel<4>(src, dst, xOffsets0, xOffsets1, xWeights, threshold);
+		break;
+	}
+}
+
+const cv::Mat &PreprocessingPipeline::run_step(Step &step, const cv::Mat &src)
+{
+	switch (step.kind) {
+	case StepKind::Gray:
+		return to_gray(src, step.output);
+	case StepKind::FusedGrayThreshold:
+		if (src.channels() == 1) {
+			cv::threshold(src, step.output, params.binarizationThreshold, 255,
+				      cv::THRESH_BINARY);
+		} else {
+			step.output.create(src.rows, src.cols, CV_8UC1);
+			if (src.channels() == 4) {
+				gray_threshold_kernel<4>(src, step.output,
+							 params.binarizationThreshold);
+			} else {
+				gray_threshold_kernel<3>(src, step.output,
+							 params.binarizationThreshold);
+			}
+		}
+		return step.output;
+	case StepKind::FusedGrayResize:
+		fused_gray_resize(src, step.output, -1);
+		return step.output;
+	case StepKind::FusedGrayResizeThreshold:
+		fused_gray_resize(src, step.output, params.binarizationThreshold);
+		return step.output;
+	case StepKind::Threshold: {
+		if (params.binarizationMode == 0) {
+			return src;
+		}
+		const cv::Mat &gray = to_gray(src, grayScratch);
+		if (params.binarizationMode == 1) {
+			cv::threshold(gray, step.output, params.binarizationThreshold, 255,
+				      cv::THRESH_BINARY);
+		} else if (params.binarizationMode == 2 || params.binarizationMode == 3) {
+			// ensure that the block size is odd
+			int block_size = params.binarizationBlockSize;
+			if (block_size % 2 == 0) {
+				block_size++;
+			}
+			cv::adaptiveThreshold(gray, step.output, 255,
+					      params.binarizationMode == 2
+						      ? cv::ADAPTIVE_THRESH_MEAN_C
+						      : cv::ADAPTIVE_THRESH_GAUSSIAN_C,
+					      cv::THRESH_BINARY, block_size, 2);
+		} else if (params.binarizationMode == 4) {
+			cv::threshold(gray, step.output, 0, 255,
+				      cv::THRESH_BINARY | cv::THRESH_TRIANGLE);
+		} else {
+			cv::threshold(gray, step.output, 0, 255,
+				      cv::THRESH_BINARY | cv::THRESH_OTSU);
+		}
+		return step.output;
+	}
+	case StepKind::Invert:
+		cv::bitwise_not(to_gray(src, grayScratch), step.output);
+		return step.output;
+	case StepKind::Denoise: {
+		int ksize = std::max(3, params.denoiseKernelSize);
+		if (ksize % 2 == 0) {
+			ksize++;
+		}
+		cv::medianBlur(src, step.output, ksize);
+		return step.output;
+	}
+	case StepKind::Erode:
+	case StepKind::Dilate: {
+		const int iterations = step.kind == StepKind::Erode ? params.erosionIterations
+								    : params.dilationIterations;
+		if (iterations <= 0) {
+			return src;
+		}
+		if (morphElement.empty()) {
+			morphElement = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3, 3));
+		}
+		if (step.kind == StepKind::Erode) {
+			cv::erode(src, step.output, morphElement, cv::Point(-1, -1), iterations);
+		} else {
+			cv::dilate(src, step.output, morphElement, cv::Point(-1, -1), iterations);
+		}
+		return step.output;
+	}
+	case StepKind::Resize: {
+		const cv::Size size = rescaled_size(src);
+		if (size == src.size()) {
+			return src;
+		}
+		cv::resize(src, step.output, size, 0, 0, cv::INTER_LINEAR);
+		return step.output;
+	}
+	}
+	return src;
+}
+
+const char *PreprocessingPipeline::step_name(StepKind kind)
+{
+	switch (kind) {
+	case StepKind::Gray:
+		return "gray";
+	case StepKind::Threshold:
+		return "threshold";
+	case StepKind::Invert:
+		return "invert";
+	case StepKind::Denoise:
+		return "denoise";
+	case StepKind::Erode:
+		return "erode";
+	case StepKind::Dilate:
+		return "dilate";
+	case StepKind::Resize:
+		return "resize";
+	case StepKind::FusedGrayThreshold:
+		return "gray+threshold";
+	case StepKind::FusedGrayResize:
+		return "gray+resize";
+	case StepKind::FusedGrayResizeThreshold:
+		return "gray+resize+threshold";
+	}
+	return "step";
+}
+
+const cv::Mat &PreprocessingPipeline::process(const cv::Mat &input)
+{
+	const cv::Mat *current = &input;
+	for (Step &step : plan) {
+		TraceScope scope(step_name(step.kind));
+		current = &run_step(step, *current);
+	}
+	return *current;
+}
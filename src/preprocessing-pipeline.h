@@ -0,0 +1,115 @@
+#ifndef PREPROCESSING_PIPELINE_H
+#define PREPROCESSING_PIPELINE_H
+
+#include <opencv2/core/mat.hpp>
+
+#include <string>
+#include <vector>
+
+enum class PreprocessingStage { Gray, Threshold, Invert, Denoise, Erode, Dilate, Resize };
+
+struct preprocessing_params {
+	int binarizationMode = 0;
+	int binarizationThreshold = 127;
+	int binarizationBlockSize = 15;
+	int erosionIterations = 1;
+	int dilationIterations = 0;
+	int denoiseKernelSize = 3;
+	int rescaleTargetSize = 35;
+};
+
+/**
+  * @brief Parse a user stage list, e.g. "gray, resize, threshold, dilate"
+  * Unknown stage names are logged and skipped.
+*/
+std::vector<PreprocessingStage> parse_preprocessing_stages(const std::string &spec);
+
+/**
+  * @brief The stage order used before the pipeline was configurable:
+  * threshold (if a binarization mode is set), dilate (if iterations > 0), resize (if enabled)
+*/
+std::vector<PreprocessingStage> legacy_preprocessing_stages(int binarizationMode,
+							    int dilationIterations,
+							    bool rescaleImage);
+
+/**
+  * @brief Whether at least thresholdPercent percent of the pixels differ between two grayscale
+  * or BGRA frames of the same size
+*/
+bool frame_changed(const cv::Mat &current, const cv::Mat &previous, int thresholdPercent);
+
+/**
+  * @brief Estimate the height of the text lines in a BGRA or grayscale image from the row
+  * profile of its Otsu binarization
+  * @return The median line height in pixels, 0 if no line was found
+*/
+int estimate_text_height(const cv::Mat &image);
+
+/**
+  * @brief An ordered list of image preprocessing stages with buffers that persist across frames.
+  *
+  * Adjacent stages that can be computed in a single pass over the image (BGRA->gray followed by
+  * resize and/or a fixed threshold) are fused into one kernel when the plan is compiled.
+*/
+class PreprocessingPipeline {
+public:
+	/**
+	  * @brief Set the stages and parameters. The execution plan is only recompiled when the
+	  * stages or the fusability of the threshold stage change.
+	*/
+	void configure(const std::vector<PreprocessingStage> &stages,
+		       const preprocessing_params &params);
+
+	/**
+	  * @brief Run the pipeline on a BGRA or grayscale image.
+	  * @return The output image, owned by the pipeline and valid until the next call
+	*/
+	const cv::Mat &process(const cv::Mat &input);
+
+	/**
+	  * @brief Scale the resize stages by a fixed factor instead of to rescaleTargetSize,
+	  * 0 goes back to the target height
+	*/
+	void set_scale(double scale) { resizeScale = scale; }
+
+private:
+	enum class StepKind {
+		Gray,
+		Threshold,
+		Invert,
+		Denoise,
+		Erode,
+		Dilate,
+		Resize,
+		FusedGrayThreshold,
+		FusedGrayResize,
+		FusedGrayResizeThreshold,
+	};
+
+	struct Step {
+		StepKind kind;
+		cv::Mat output;
+	};
+
+	static const char *step_name(StepKind kind);
+	void compile();
+	const cv::Mat &run_step(Step &step, const cv::Mat &src);
+	void fused_gray_resize(const cv::Mat &src, cv::Mat &dst, int threshold);
+	cv::Size rescaled_size(const cv::Mat &src) const;
+
+	std::vector<PreprocessingStage> stages;
+	preprocessing_params params;
+	std::vector<Step> plan;
+	cv::Mat morphElement;
+	cv::Mat grayScratch;
+	double resizeScale = 0.0;
+
+	// horizontal resampling tables, reused while the source and target widths don't change
+	int xTableSrcWidth = 0;
+	int xTableDstWidth = 0;
+	std::vector<int> xOffsets0;
+	std::vector<int> xOffsets1;
+	std::vector<int> xWeights;
+};
+
+#endif /* PREPROCESSING_PIPELINE_H */
@@ -0,0 +1,293 @@
+#include "result-publisher.h"
+#include "ocr-result-ring.h"
+#include "obs-utils.h"
+#include "plugin-support.h"
+#include "text-utils.h"
+
+#include <obs-module.h>
+#include <util/platform.h>
+
+#include <inja/inja.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <set>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+// names published under by this process, a second filter must not take over a ring or socket
+std::mutex names_mutex;
+std::set<std::string> names_in_use;
+
+} // namespace
+
+ResultPublisher::ResultPublisher(const std::string &name_, bool withSocket_)
+	: name(name_),
+	  withSocket(withSocket_)
+{
+	{
+		std::lock_guard<std::mutex> lock(names_mutex);
+		claimed = names_in_use.insert(name).second;
+	}
+	if (!claimed) {
+		obs_log(LOG_WARNING,
+			"Another filter already publishes results as '%s', pick a different "
+			"publish name",
+			name.c_str());
+		return;
+	}
+	open_shared_memory();
+	if (withSocket) {
+		open_socket();
+	}
+}
+
+ResultPublisher::~ResultPublisher()
+{
+	if (!claimed) {
+		return;
+	}
+	close_socket();
+	close_shared_memory();
+	std::lock_guard<std::mutex> lock(names_mutex);
+	names_in_use.erase(name);
+}
+
+void ResultPublisher::open_shared_memory()
+{
+	const std::string shm_name = ocr_ring_shm_name(name);
+	const size_t size = sizeof(ocr_ring_header);
+	void *memory = nullptr;
+#ifdef _WIN32
+	mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, (DWORD)size,
+				     shm_name.c_str());
+	if (mapping == nullptr) {
+		obs_log(LOG_ERROR, "Failed to create the result ring '%s'", shm_name.c_str());
+		return;
+	}
+	memory = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+#else
+	// a segment left behind by a crash is reused
+	shm_fd = shm_open(shm_name.c_str(), O_CREAT | O_RDWR, 0600);
+	if (shm_fd < 0 || ftruncate(shm_fd, (off_t)size) != 0) {
+		obs_log(LOG_ERROR, "Failed to create the result ring '%s': %s", shm_name.c_str(),
+			strerror(errno));
+		return;
+	}
+	memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+	if (memory == MAP_FAILED) {
+		memory = nullptr;
+	}
+#endif
+	if (memory == nullptr) {
+		obs_log(LOG_ERROR, "Failed to map the result ring '%s'", shm_name.c_str());
+		close_shared_memory();
+		return;
+	}
+
+	ring = static_cast<ocr_ring_header *>(memory);
+	if (ring->magic == OCR_RING_MAGIC && ring->version == OCR_RING_VERSION &&
+	    ring->capacity == OCR_RING_CAPACITY &&
+	    ring->record_size == (uint32_t)sizeof(ocr_ring_record)) {
+		// a valid ring, e.g. left behind by a crash: continue its sequence so that readers
+		// attached to it don't see it go backwards
+		sequence = ring->write_sequence.load(std::memory_order_acquire);
+		obs_log(LOG_INFO, "Publishing results to shared memory '%s'", shm_name.c_str());
+		return;
+	}
+	ring->magic = 0;
+	ring->version = OCR_RING_VERSION;
+	ring->capacity = OCR_RING_CAPACITY;
+	ring->record_size = (uint32_t)sizeof(ocr_ring_record);
+	ring->write_sequence.store(0, std::memory_order_relaxed);
+	for (ocr_ring_record &record : ring->records) {
+		record.lock.store(0, std::memory_order_relaxed);
+	}
+	std::atomic_thread_fence(std::memory_order_release);
+	ring->magic = OCR_RING_MAGIC;
+	obs_log(LOG_INFO, "Publishing results to shared memory '%s'", shm_name.c_str());
+}
+
+void ResultPublisher::close_shared_memory()
+{
+#ifdef _WIN32
+	if (ring != nullptr) {
+		UnmapViewOfFile(ring);
+	}
+	if (mapping != nullptr) {
+		CloseHandle(mapping);
+		mapping = nullptr;
+	}
+#else
+	if (ring != nullptr) {
+		munmap(ring, sizeof(ocr_ring_header));
+	}
+	if (shm_fd >= 0) {
+		close(shm_fd);
+		shm_fd = -1;
+		shm_unlink(ocr_ring_shm_name(name).c_str());
+	}
+#endif
+	ring = nullptr;
+}
+
+void ResultPublisher::open_socket()
+{
+#ifdef _WIN32
+	obs_log(LOG_WARNING, "The result socket is not supported on Windows, use shared memory");
+#else
+	const std::string path = ocr_ring_socket_path(name);
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path)) {
+		obs_log(LOG_ERROR, "Result socket path is too long: %s", path.c_str());
+		return;
+	}
+	strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+	listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listen_fd < 0) {
+		obs_log(LOG_ERROR, "Failed to create the result socket: %s", strerror(errno));
+		return;
+	}
+	unlink(path.c_str());
+	// like the ring, only readable by the user running OBS. Nobody can connect before listen()
+	if (bind(listen_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+	    chmod(path.c_str(), 0600) != 0 || listen(listen_fd, 8) != 0) {
+		obs_log(LOG_ERROR, "Failed to listen on the result socket %s: %s", path.c_str(),
+			strerror(errno));
+		close(listen_fd);
+		listen_fd = -1;
+		return;
+	}
+	// clients are accepted when publishing, never wait for them
+	fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL) | O_NONBLOCK);
+	obs_log(LOG_INFO, "Publishing results to socket %s", path.c_str());
+#endif
+}
+
+void ResultPublisher::close_socket()
+{
+#ifndef _WIN32
+	for (int fd : client_fds) {
+		close(fd);
+	}
+	client_fds.clear();
+	if (listen_fd >= 0) {
+		close(listen_fd);
+		listen_fd = -1;
+		unlink(ocr_ring_socket_path(name).c_str());
+	}
+#endif
+}
+
+void ResultPublisher::send_to_socket_clients(const ocr_result_event &event,
+					     uint64_t publish_time_ns)
+{
+#ifdef _WIN32
+	UNUSED_PARAMETER(event);
+	UNUSED_PARAMETER(publish_time_ns);
+#else
+	if (listen_fd < 0) {
+		return;
+	}
+	int client_fd;
+	while ((client_fd = accept(listen_fd, nullptr, nullptr)) >= 0) {
+		fcntl(client_fd, F_SETFL, fcntl(client_fd, F_GETFL) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+		int on = 1;
+		setsockopt(client_fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+		client_fds.push_back(client_fd);
+	}
+	if (client_fds.empty()) {
+		return;
+	}
+
+	// one JSON object per line, newlines in the text are escaped by the encoder
+	nlohmann::json json;
+	json["sequence"] = sequence;
+	json["frame_timestamp"] = event.frame_timestamp_ns;
+	json["publish_timestamp"] = publish_time_ns;
+	json["confidence"] = event.confidence;
+	json["text"] = event.text;
+	// the same fields as the boxes of the ocr_result signal
+	nlohmann::json boxes = nlohmann::json::array();
+	for (const OCRBox &box : event.boxes) {
+		nlohmann::json item;
+		item["text"] = box.text;
+		item["x"] = box.box.x;
+		item["y"] = box.box.y;
+		item["width"] = box.box.width;
+		item["height"] = box.box.height;
+		boxes.push_back(item);
+	}
+	json["boxes"] = boxes;
+	const std::string line = json.dump() + "\n";
+
+#ifdef MSG_NOSIGNAL
+	const int flags = MSG_NOSIGNAL;
+#else
+	const int flags = 0;
+#endif
+	client_fds.erase(std::remove_if(client_fds.begin(), client_fds.end(),
+					[&line, flags](int fd) {
+						// a partial write would corrupt the stream,
+						// drop clients that fall behind
+						const ssize_t sent =
+							send(fd, line.data(), line.size(), flags);
+						if (sent != (ssize_t)line.size()) {
+							close(fd);
+							return true;
+						}
+						return false;
+					}),
+			 client_fds.end());
+#endif
+}
+
+void ResultPublisher::publish(const ocr_result_event &event)
+{
+	const uint64_t publish_time_ns = os_gettime_ns();
+	sequence++;
+
+	if (ring != nullptr) {
+		ocr_ring_record &record = ring->records[sequence % OCR_RING_CAPACITY];
+		record.lock.store(2 * sequence - 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		record.sequence = sequence;
+		record.frame_timestamp_ns = event.frame_timestamp_ns;
+		record.publish_timestamp_ns = publish_time_ns;
+		record.confidence = event.confidence;
+		// readers get valid UTF-8, a long text loses its last whole code points
+		record.text_length =
+			(uint32_t)utf8_prefix_length(event.text, (size_t)OCR_RING_TEXT_SIZE - 1);
+		memcpy(record.text, event.text.data(), record.text_length);
+		record.text[record.text_length] = '\0';
+		record.box_count =
+			(uint32_t)std::min(event.boxes.size(), (size_t)OCR_RING_MAX_BOXES);
+		for (uint32_t i = 0; i < record.box_count; i++) {
+			const cv::Rect &box = event.boxes[i].box;
+			record.boxes[i] = ocr_ring_box{box.x, box.y, box.width, box.height};
+		}
+
+		record.lock.store(2 * sequence, std::memory_order_release);
+		ring->write_sequence.store(sequence, std::memory_order_release);
+	}
+
+	send_to_socket_clients(event, publish_time_ns);
+}
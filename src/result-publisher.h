@@ -0,0 +1,53 @@
+#ifndef RESULT_PUBLISHER_H
+#define RESULT_PUBLISHER_H
+
+#include "filter-data.h"
+
+#include <string>
+#include <vector>
+
+struct ocr_ring_header;
+
+/**
+  * @brief Publishes results to local processes through a shared-memory ring and, on POSIX
+  * systems, a Unix domain socket streaming one JSON object per line.
+  *
+  * Owned and used by the worker thread only. Publishing never blocks: socket clients that
+  * can't keep up are dropped.
+*/
+class ResultPublisher {
+public:
+	ResultPublisher(const std::string &name, bool withSocket);
+	~ResultPublisher();
+	ResultPublisher(const ResultPublisher &) = delete;
+	ResultPublisher &operator=(const ResultPublisher &) = delete;
+
+	const std::string &get_name() const { return name; }
+	// false when another filter of this process already publishes under the name
+	bool is_open() const { return claimed; }
+	bool has_socket() const { return withSocket; }
+
+	void publish(const ocr_result_event &event);
+
+private:
+	void open_shared_memory();
+	void close_shared_memory();
+	void open_socket();
+	void close_socket();
+	void send_to_socket_clients(const ocr_result_event &event, uint64_t publish_time_ns);
+
+	std::string name;
+	bool withSocket;
+	bool claimed = false;
+	ocr_ring_header *ring = nullptr;
+	uint64_t sequence = 0;
+#ifdef _WIN32
+	void *mapping = nullptr;
+#else
+	int shm_fd = -1;
+	int listen_fd = -1;
+	std::vector<int> client_fds;
+#endif
+};
+
+#endif /* RESULT_PUBLISHER_H */
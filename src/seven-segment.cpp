@@ -0,0 +1,337 @@
+#include "seven-segment.h"
+#include "plugin-support.h"
+
+#include <obs-module.h>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+namespace {
+
+// segment regions relative to the digit cell: x0, y0, x1, y1, in the order a, b, c, d, e, f, g
+//  aaa
+// f   b
+//  ggg
+// e   c
+//  ddd
+constexpr float SEGMENT_REGIONS[7][4] = {
+	{0.25f, 0.00f, 0.75f, 0.14f}, {0.72f, 0.10f, 1.00f, 0.44f}, {0.72f, 0.56f, 1.00f, 0.90f},
+	{0.25f, 0.86f, 0.75f, 1.00f}, {0.00f, 0.56f, 0.28f, 0.90f}, {0.00f, 0.10f, 0.28f, 0.44f},
+	{0.25f, 0.43f, 0.75f, 0.57f},
+};
+
+// lit segment patterns (bit 0 = a ... bit 6 = g), with the common variants of 6, 7 and 9
+constexpr struct {
+	unsigned char pattern;
+	char character;
+} SEGMENT_PATTERNS[] = {
+	{0x3F, '0'}, {0x06, '1'}, {0x5B, '2'}, {0x4F, '3'}, {0x66, '4'}, {0x6D, '5'}, {0x7D, '6'},
+	{0x7C, '6'}, {0x07, '7'}, {0x27, '7'}, {0x7F, '8'}, {0x6F, '9'}, {0x67, '9'}, {0x40, '-'},
+};
+
+// a segment region lit above this fraction is on
+constexpr double SEGMENT_ON_RATIO = 0.3;
+// a digit narrower than this fraction of its height is a 1 (only segments b and c)
+constexpr double NARROW_DIGIT_ASPECT = 0.35;
+// blobs lower than this fraction of the digit height are punctuation or a minus sign
+constexpr double SMALL_BLOB_HEIGHT = 0.4;
+// used for 1s when there is no wider digit to take the width from
+constexpr double DEFAULT_DIGIT_ASPECT = 0.55;
+// the dots of colons and decimal points are at most this fraction of the digit height
+constexpr double DOT_SIZE = 0.25;
+
+struct column_run {
+	int x0;
+	int x1;
+	int y0;
+	int y1;
+	// vertically separate blobs in the run, and the bottom of the first and top of the last
+	int blobs;
+	int first_y1;
+	int last_y0;
+};
+
+bool is_punctuation(char c)
+{
+	return c == ':' || c == '.';
+}
+
+int popcount7(unsigned int bits)
+{
+	int count = 0;
+	for (int i = 0; i < 7; i++) {
+		count += (int)((bits >> i) & 1u);
+	}
+	return count;
+}
+
+} // namespace
+
+void SevenSegmentDecoder::binarize(const cv::Mat &image)
+{
+	const cv::Mat *src = &image;
+	if (image.channels() != 1) {
+		cv::cvtColor(image, gray,
+			     image.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+		src = &gray;
+	}
+	cv::threshold(*src, binary, 0, 255, cv::THRESH_BINARY | cv::THRESH_OTSU);
+	// lit segments cover less of the display than the background, whatever the polarity
+	if (cv::countNonZero(binary) > binary.cols * binary.rows / 2) {
+		cv::bitwise_not(binary, binary);
+	}
+	cv::integral(binary, integral, CV_32S);
+}
+
+double SevenSegmentDecoder::fill_ratio(const cv::Rect &rect) const
+{
+	const cv::Rect r = rect & cv::Rect(0, 0, binary.cols, binary.rows);
+	if (r.area() <= 0) {
+		return 0.0;
+	}
+	const int sum = integral.at<int>(r.y + r.height, r.x + r.width) -
+			integral.at<int>(r.y, r.x + r.width) -
+			integral.at<int>(r.y + r.height, r.x) + integral.at<int>(r.y, r.x);
+	return (double)sum / 255.0 / (double)r.area();
+}
+
+void SevenSegmentDecoder::detect_cells()
+{
+	detectedCells.clear();
+
+	// digits are separated by dark columns, the gaps between the segments of one digit are
+	// bridged by the horizontal segments or are narrower than the tolerance
+	cv::reduce(binary, columns, 0, cv::REDUCE_SUM, CV_32S);
+	const int gap_tolerance = std::max(1, binary.rows / 40);
+	std::vector<column_run> runs;
+	int run_start = -1;
+	int last_lit = -1;
+	for (int x = 0; x <= binary.cols; x++) {
+		const bool lit = x < binary.cols && columns.at<int>(0, x) >= 2 * 255;
+		if (lit) {
+			if (run_start < 0) {
+				run_start = x;
+			}
+			last_lit = x;
+		} else if (run_start >= 0 && (x == binary.cols || x - last_lit > gap_tolerance)) {
+			runs.push_back(column_run{run_start, last_lit + 1, 0, 0, 0, 0, 0});
+			run_start = -1;
+		}
+	}
+
+	// vertical extent and blobs of every run
+	int digit_height = 0;
+	for (column_run &run : runs) {
+		run.y0 = -1;
+		bool in_blob = false;
+		for (int y = 0; y < binary.rows; y++) {
+			const bool lit = fill_ratio(cv::Rect(run.x0, y, run.x1 - run.x0, 1)) > 0.0;
+			if (lit && !in_blob) {
+				run.blobs++;
+				run.last_y0 = y;
+				if (run.y0 < 0) {
+					run.y0 = y;
+				}
+			} else if (!lit && in_blob && run.blobs == 1) {
+				run.first_y1 = y;
+			}
+			if (lit) {
+				run.y1 = y + 1;
+			}
+			in_blob = lit;
+		}
+		if (run.blobs == 1) {
+			run.first_y1 = run.y1;
+		}
+		digit_height = std::max(digit_height, run.y1 - run.y0);
+	}
+	if (digit_height == 0) {
+		return;
+	}
+
+	// a colon is two dots, one above the other, in a narrow run
+	const int dot_size = (int)(DOT_SIZE * digit_height);
+	std::vector<bool> colons(runs.size(), false);
+	for (size_t i = 0; i < runs.size(); i++) {
+		const column_run &run = runs[i];
+		colons[i] = run.blobs == 2 && run.x1 - run.x0 <= dot_size &&
+			    run.first_y1 - run.y0 <= dot_size && run.y1 - run.last_y0 <= dot_size;
+	}
+
+	// the display spans from the top of the highest to the bottom of the lowest digit
+	int top = binary.rows;
+	int bottom = 0;
+	std::vector<int> widths;
+	for (size_t i = 0; i < runs.size(); i++) {
+		const column_run &run = runs[i];
+		if (!colons[i] && run.y1 - run.y0 >= (int)(SMALL_BLOB_HEIGHT * digit_height)) {
+			top = std::min(top, run.y0);
+			bottom = std::max(bottom, run.y1);
+			if (run.x1 - run.x0 >= (int)(NARROW_DIGIT_ASPECT * digit_height)) {
+				widths.push_back(run.x1 - run.x0);
+			}
+		}
+	}
+	const int height = bottom - top;
+	int digit_width = (int)(DEFAULT_DIGIT_ASPECT * height);
+	if (!widths.empty()) {
+		std::nth_element(widths.begin(), widths.begin() + (long)(widths.size() / 2),
+				 widths.end());
+		digit_width = widths[widths.size() / 2];
+	}
+
+	for (size_t i = 0; i < runs.size(); i++) {
+		const column_run &run = runs[i];
+		const int run_width = run.x1 - run.x0;
+		const int run_height = run.y1 - run.y0;
+		const cv::Rect run_rect(run.x0, run.y0, run_width, run_height);
+		if (colons[i]) {
+			detectedCells.push_back(Cell{run_rect, ':'});
+			continue;
+		}
+		if (run_height < (int)(SMALL_BLOB_HEIGHT * height)) {
+			// a minus sign sits in the middle and is wide, a decimal point is a dot
+			// on the baseline, anything else is noise
+			const int center = (run.y0 + run.y1) / 2;
+			if (run_width >= digit_width / 2 && center > top + height / 3 &&
+			    center < bottom - height / 3) {
+				detectedCells.push_back(
+					Cell{cv::Rect(run.x0, top, run_width, height), 0});
+			} else if (run.blobs == 1 && run_width <= dot_size &&
+				   run_height <= dot_size && center >= bottom - height / 4) {
+				detectedCells.push_back(Cell{run_rect, '.'});
+			}
+			continue;
+		}
+		if (run_width < (int)(NARROW_DIGIT_ASPECT * height)) {
+			// a 1 only lights the right segments, sample it in a full width cell
+			detectedCells.push_back(
+				Cell{cv::Rect(run.x1 - digit_width, top, digit_width, height), 0});
+			continue;
+		}
+		detectedCells.push_back(Cell{cv::Rect(run.x0, top, run_width, height), 0});
+	}
+}
+
+SevenSegmentDecoder::Digit SevenSegmentDecoder::decode_cell(const cv::Rect &cell) const
+{
+	unsigned int pattern = 0;
+	double margin = 1.0;
+	for (int i = 0; i < 7; i++) {
+		const float *region = SEGMENT_REGIONS[i];
+		const int x0 = cell.x + (int)std::lround(region[0] * (float)cell.width);
+		const int y0 = cell.y + (int)std::lround(region[1] * (float)cell.height);
+		const int x1 = cell.x + (int)std::lround(region[2] * (float)cell.width);
+		const int y1 = cell.y + (int)std::lround(region[3] * (float)cell.height);
+		const double ratio = fill_ratio(cv::Rect(x0, y0, x1 - x0, y1 - y0));
+		if (ratio > SEGMENT_ON_RATIO) {
+			pattern |= 1u << i;
+		}
+		// how far the fill ratio is from the on/off decision, 1 for a clear segment
+		const double distance = std::abs(ratio - SEGMENT_ON_RATIO) / SEGMENT_ON_RATIO;
+		margin = std::min(margin, std::min(1.0, distance));
+	}
+
+	// exact match, or the nearest pattern one segment away at a lower confidence
+	Digit digit{'?', cell, 0};
+	int best_distance = 8;
+	for (const auto &entry : SEGMENT_PATTERNS) {
+		const int distance = popcount7(pattern ^ entry.pattern);
+		if (distance < best_distance) {
+			best_distance = distance;
+			digit.character = entry.character;
+		}
+	}
+	if (best_distance == 0) {
+		digit.confidence = (int)(100.0 * margin);
+	} else if (best_distance == 1) {
+		digit.confidence = (int)(50.0 * margin);
+	} else {
+		digit.character = '?';
+	}
+	return digit;
+}
+
+const std::vector<SevenSegmentDecoder::Digit> &
+SevenSegmentDecoder::decode(const cv::Mat &image, const std::vector<cv::Rect> &cells)
+{
+	digits.clear();
+	if (image.empty()) {
+		return digits;
+	}
+
+	binarize(image);
+	if (!cells.empty()) {
+		for (const cv::Rect &cell : cells) {
+			if (cell.width > 0 && cell.height > 0) {
+				digits.push_back(decode_cell(cell));
+			}
+		}
+		return digits;
+	}
+	detect_cells();
+	for (const Cell &cell : detectedCells) {
+		if (cell.punctuation != 0) {
+			digits.push_back(Digit{cell.punctuation, cell.rect, 100});
+		} else if (cell.rect.width > 0 && cell.rect.height > 0) {
+			digits.push_back(decode_cell(cell.rect));
+		}
+	}
+	return digits;
+}
+
+std::vector<cv::Rect> parse_seven_segment_cells(const std::string &spec)
+{
+	std::vector<cv::Rect> cells;
+	std::istringstream cell_stream(spec);
+	std::string cell_spec;
+	while (std::getline(cell_stream, cell_spec, ';')) {
+		if (cell_spec.find_first_not_of(" \t") == std::string::npos) {
+			continue;
+		}
+		std::istringstream values(cell_spec);
+		cv::Rect cell;
+		char comma1 = 0, comma2 = 0, comma3 = 0;
+		if (!(values >> cell.x >> comma1 >> cell.y >> comma2 >> cell.width >> comma3 >>
+		      cell.height) ||
+		    comma1 != ',' || comma2 != ',' || comma3 != ',' || cell.width <= 0 ||
+		    cell.height <= 0) {
+			obs_log(LOG_WARNING, "Invalid seven-segment cell '%s', expected x,y,w,h",
+				cell_spec.c_str());
+			continue;
+		}
+		cells.push_back(cell);
+	}
+	return cells;
+}
+
+std::string seven_segment_text(const std::vector<SevenSegmentDecoder::Digit> &digits,
+			       int &confidence)
+{
+	std::string text;
+	confidence = 0;
+	if (digits.empty()) {
+		return text;
+	}
+	int confidence_sum = 0;
+	for (size_t i = 0; i < digits.size(); i++) {
+		const cv::Rect &cell = digits[i].cell;
+		// separate fields (e.g. home and away scores) when the gap is wider than a digit,
+		// punctuation belongs to the digits around it
+		if (i > 0 && !is_punctuation(digits[i].character) &&
+		    !is_punctuation(digits[i - 1].character)) {
+			const cv::Rect &previous = digits[i - 1].cell;
+			if (cell.x - (previous.x + previous.width) > previous.width) {
+				text += ' ';
+			}
+		}
+		text += digits[i].character;
+		confidence_sum += digits[i].confidence;
+	}
+	confidence = confidence_sum / (int)digits.size();
+	return text;
+}
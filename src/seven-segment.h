@@ -0,0 +1,65 @@
+#ifndef SEVEN_SEGMENT_H
+#define SEVEN_SEGMENT_H
+
+#include <opencv2/core/mat.hpp>
+
+#include <string>
+#include <vector>
+
+/**
+  * @brief Geometric decoder for seven-segment (LED/LCD) digit displays.
+  *
+  * Every digit cell is sampled at the seven segment positions, the fill ratio of each region
+  * decides whether the segment is lit and the lit pattern is looked up in a table. Cells are
+  * either detected from the lit pixel columns or given by the user. Detected colons and decimal
+  * points are recognized by their shape. Buffers persist across frames.
+*/
+class SevenSegmentDecoder {
+public:
+	struct Digit {
+		char character;
+		cv::Rect cell;
+		// 0-100, how clearly every segment is either lit or dark
+		int confidence;
+	};
+
+	/**
+	  * @brief Decode the digits in a BGRA, grayscale or binary image
+	  * @param cells Digit cells in image coordinates, empty to detect them
+	  * @return The digits from left to right, valid until the next call
+	*/
+	const std::vector<Digit> &decode(const cv::Mat &image, const std::vector<cv::Rect> &cells);
+
+private:
+	struct Cell {
+		cv::Rect rect;
+		// ':' or '.' for punctuation recognized on detection, 0 for a digit to sample
+		char punctuation;
+	};
+
+	void binarize(const cv::Mat &image);
+	void detect_cells();
+	Digit decode_cell(const cv::Rect &cell) const;
+	double fill_ratio(const cv::Rect &rect) const;
+
+	cv::Mat gray;
+	cv::Mat binary;
+	cv::Mat integral;
+	cv::Mat columns;
+	std::vector<Cell> detectedCells;
+	std::vector<Digit> digits;
+};
+
+/**
+  * @brief Parse user digit cells, "x,y,w,h;x,y,w,h;..." Invalid entries are logged and skipped.
+*/
+std::vector<cv::Rect> parse_seven_segment_cells(const std::string &spec);
+
+/**
+  * @brief Join decoded digits into text, with a space between digits that are far apart
+  * @param confidence Mean confidence of the digits (output)
+*/
+std::string seven_segment_text(const std::vector<SevenSegmentDecoder::Digit> &digits,
+			       int &confidence);
+
+#endif /* SEVEN_SEGMENT_H */
@@ -0,0 +1,341 @@
+#include "ocr-engine.h"
+#include "filter-data.h"
+#include "tesseract-ocr-utils.h"
+#include "plugin-support.h"
+#include "obs-utils.h"
+#include "model-manager.h"
+#include "consts.h"
+
+#include <obs-module.h>
+#include <util/platform.h>
+
+#include <tesseract/baseapi.h>
+#include <tesseract/ocrclass.h>
+#include <tesseract/resultiterator.h>
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+class TesseractEngine : public OcrEngine {
+public:
+	TesseractEngine(tesseract::TessBaseAPI *api_, std::string language_, std::string variant_)
+		: api(api_),
+		  language(std::move(language_)),
+		  variant(std::move(variant_))
+	{
+	}
+	~TesseractEngine() override
+	{
+		api->End();
+		delete api;
+	}
+
+	const char *name() const override { return "Tesseract"; }
+
+	void configure(const ocr_settings &settings) override
+	{
+		// only touch what changed, setting a variable is not free
+		if (!configured || settings.pageSegmentationMode != pageSegmentationMode) {
+			pageSegmentationMode = settings.pageSegmentationMode;
+			api->SetPageSegMode(
+				static_cast<tesseract::PageSegMode>(pageSegmentationMode));
+		}
+		if (!configured || settings.char_whitelist != char_whitelist) {
+			char_whitelist = settings.char_whitelist;
+			api->SetVariable("tessedit_char_whitelist", char_whitelist.c_str());
+		}
+		configured = true;
+	}
+
+	bool recognize(const ocr_request &request, const ocr_settings &settings,
+		       ocr_engine_result &result) override
+	{
+		const uint64_t startNs = os_gettime_ns();
+		const bool ok = recognize_image(request, settings, result);
+		if (!warmingUp) {
+			record_model_frame(language, variant,
+					   (double)(os_gettime_ns() - startNs) / 1e6);
+		}
+		return ok;
+	}
+
+	void warm_up() override
+	{
+		// the first recognition pays for lazy allocations, it isn't a frame
+		warmingUp = true;
+		OcrEngine::warm_up();
+		warmingUp = false;
+	}
+
+private:
+	bool recognize_image(const ocr_request &request, const ocr_settings &settings,
+			     ocr_engine_result &result)
+	{
+		const cv::Mat &image = request.image;
+		api->SetImage(image.data, image.cols, image.rows, image.channels(),
+			      (int)image.step);
+		tesseract::ETEXT_DESC monitor;
+		tesseract::ETEXT_DESC *deadline = nullptr;
+		if (request.deadlineMs > 0) {
+			// one deadline for the whole request, also when it has several lines
+			monitor.set_deadline_msecs((int32_t)request.deadlineMs);
+			deadline = &monitor;
+		}
+		if (request.lines != nullptr) {
+			return recognize_lines(*request.lines, settings, deadline, result);
+		}
+
+		// run the tesseract model
+		if (!recognize_until(deadline, result)) {
+			return result.timedOut;
+		}
+		char *text = api->GetUTF8Text();
+		if (text == nullptr) {
+			return false;
+		}
+		std::string recognitionResult = std::string(text);
+		delete[] text;
+
+		// get the confidence of the recognition result
+		result.confidence = api->MeanTextConf();
+		if (result.confidence >= settings.conf_threshold) {
+			result.text = recognitionResult;
+		}
+		if (request.wantBoxes) {
+			extract_text_detection_boxes(settings, image.size(), result.boxes);
+		}
+		if (request.wantLines) {
+			extract_text_lines(result.lines);
+		}
+		return true;
+	}
+
+	/**
+	  * @brief Recognize the image or rectangle that is set, GetUTF8Text and the iterators then
+	  * return the cached result. Tesseract checks the deadline between words, the page layout
+	  * analysis before them can't be interrupted.
+	  * @return false if recognition failed or the deadline passed, then result.timedOut is set
+	*/
+	bool recognize_until(tesseract::ETEXT_DESC *deadline, ocr_engine_result &result)
+	{
+		if (deadline == nullptr) {
+			// GetUTF8Text recognizes on demand
+			return true;
+		}
+		const int retval = api->Recognize(deadline);
+		if (deadline->deadline_exceeded()) {
+			result.timedOut = true;
+			record_model_timeout(language, variant);
+			return false;
+		}
+		return retval == 0;
+	}
+
+	bool recognize_lines(const std::vector<cv::Rect> &lines, const ocr_settings &settings,
+			     tesseract::ETEXT_DESC *deadline, ocr_engine_result &result)
+	{
+		if (lines.empty()) {
+			// nothing that looks like text, skip recognition altogether
+			return true;
+		}
+
+		api->SetPageSegMode(tesseract::PSM_SINGLE_LINE);
+		int confidence_sum = 0;
+		for (const cv::Rect &line : lines) {
+			api->SetRectangle(line.x, line.y, line.width, line.height);
+			if (!recognize_until(deadline, result)) {
+				if (result.timedOut) {
+					break;
+				}
+				continue;
+			}
+			char *text = api->GetUTF8Text();
+			if (text == nullptr) {
+				continue;
+			}
+			std::string lineText = strip(text);
+			delete[] text;
+			const int confidence = api->MeanTextConf();
+			if (lineText.empty() || confidence < settings.conf_threshold) {
+				continue;
+			}
+			if (!result.text.empty()) {
+				result.text += "\n";
+			}
+			result.text += lineText;
+			confidence_sum += confidence;
+			result.boxes.push_back(OCRBox{lineText, line});
+		}
+		if (!result.boxes.empty()) {
+			result.confidence = confidence_sum / (int)result.boxes.size();
+		}
+		// restore the configured mode for the full-frame path
+		api->SetPageSegMode(static_cast<tesseract::PageSegMode>(pageSegmentationMode));
+		return true;
+	}
+
+	void extract_text_detection_boxes(const ocr_settings &settings, cv::Size imageSize,
+					  std::vector<OCRBox> &boxes)
+	{
+		// extract the text detection boxes
+		tesseract::ResultIterator *ri = api->GetIterator();
+		if (ri == nullptr) {
+			return;
+		}
+		tesseract::PageIteratorLevel level = tesseract::RIL_WORD;
+		if (settings.pageSegmentationMode == tesseract::PSM_SINGLE_CHAR) {
+			level = tesseract::RIL_SYMBOL;
+		}
+		do {
+			if (ri->Empty(level)) {
+				continue;
+			}
+			// is this a word box?
+			if (level == tesseract::RIL_WORD) {
+				// get the confidence of the word
+				float conf = ri->Confidence(level);
+				if ((int)conf < settings.conf_threshold) {
+					continue;
+				}
+			}
+			int left, top, right, bottom;
+			ri->BoundingBox(level, &left, &top, &right, &bottom);
+			// get area of box
+			const int area = (right - left) * (bottom - top);
+			// skip boxes that are too small or too big relative to the image size
+			if (area < 100 || area > (imageSize.width * imageSize.height) / 2) {
+				continue;
+			}
+			OCRBox box;
+			box.box = cv::Rect(left, top, right - left, bottom - top);
+			// get the text of the box
+			char *text = ri->GetUTF8Text(level);
+			if (text != nullptr) {
+				box.text = text;
+				delete[] text;
+			}
+			boxes.push_back(box);
+		} while (ri->Next(level));
+		delete ri;
+	}
+
+	void extract_text_lines(std::vector<cv::Rect> &lines)
+	{
+		tesseract::ResultIterator *ri = api->GetIterator();
+		if (ri == nullptr) {
+			return;
+		}
+		do {
+			if (ri->Empty(tesseract::RIL_TEXTLINE)) {
+				continue;
+			}
+			int left, top, right, bottom;
+			ri->BoundingBox(tesseract::RIL_TEXTLINE, &left, &top, &right, &bottom);
+			lines.push_back(cv::Rect(left, top, right - left, bottom - top));
+		} while (ri->Next(tesseract::RIL_TEXTLINE));
+		delete ri;
+	}
+
+	tesseract::TessBaseAPI *api;
+	// for the model report
+	std::string language;
+	std::string variant;
+	bool configured = false;
+	bool warmingUp = false;
+	int pageSegmentationMode = 0;
+	std::string char_whitelist;
+};
+
+} // namespace
+
+std::unique_ptr<OcrEngine> create_tesseract_engine(filter_data *tf, const ocr_settings &settings)
+{
+	tesseract::TessBaseAPI *api = nullptr;
+	std::string variant;
+	try {
+		std::vector<std::string> config_files;
+
+		if (is_valid_output_source_name(settings.output_image_source_name.c_str())) {
+			// make sure mask folder exists
+			check_plugin_config_folder_exists();
+		}
+
+		// if the user patterns are not empty, apply them
+		if (!settings.user_patterns.empty()) {
+			check_plugin_config_folder_exists();
+			// save the user patterns to a file in the module's config folder
+			std::string filename = "user-patterns-" + tf->unique_id + ".txt";
+			std::string user_patterns_filepath =
+				obs_module_config_path(filename.c_str());
+			obs_log(LOG_INFO, "Saving user patterns to: %s",
+				user_patterns_filepath.c_str());
+			std::ofstream user_patterns_file(user_patterns_filepath);
+			user_patterns_file << settings.user_patterns;
+			user_patterns_file.close();
+
+			// create a .config file pointing to the patterns file
+			filename = "user-patterns" + tf->unique_id + ".config";
+			std::string patterns_config_filepath =
+				obs_module_config_path(filename.c_str());
+			obs_log(LOG_INFO, "Saving user patterns config to: %s",
+				patterns_config_filepath.c_str());
+			std::ofstream patterns_config_file(patterns_config_filepath);
+			patterns_config_file << "user_patterns_file " << user_patterns_filepath
+					     << "\n";
+			patterns_config_file.close();
+
+			config_files.push_back(patterns_config_filepath);
+		}
+		// Init() takes the config file names as a non-const char* array
+		std::vector<char *> configs;
+		for (std::string &config_file : config_files) {
+			configs.push_back(&config_file[0]);
+		}
+
+		variant = settings.model_variant;
+		std::string datapath = find_model_folder(tf->tesseractTraineddataFilepath, variant,
+							 settings.language);
+		if (datapath.empty()) {
+			obs_log(LOG_WARNING, "No %s model of '%s', using the best one",
+				variant.c_str(), settings.language.c_str());
+			variant = MODEL_VARIANT_BEST;
+			datapath = tf->tesseractTraineddataFilepath;
+		}
+		obs_log(LOG_INFO, "Loading tesseract model '%s' (%s) from: %s",
+			settings.language.c_str(), variant.c_str(), datapath.c_str());
+
+		api = new tesseract::TessBaseAPI();
+
+		// Load model
+		const uint64_t loadStartNs = os_gettime_ns();
+		const uint64_t residentBefore = os_get_proc_resident_size();
+		int retval = api->Init(datapath.c_str(), settings.language.c_str(),
+				       tesseract::OEM_LSTM_ONLY,
+				       configs.empty() ? nullptr : configs.data(),
+				       (int)configs.size(), nullptr, nullptr, false);
+		if (retval != 0) {
+			throw std::runtime_error("Failed to initialize tesseract model");
+		}
+		std::error_code ec;
+		const uintmax_t fileBytes = std::filesystem::file_size(
+			std::filesystem::path(datapath) / (settings.language + ".traineddata"), ec);
+		record_model_load(settings.language, variant,
+				  (double)(os_gettime_ns() - loadStartNs) / 1e6,
+				  (int64_t)os_get_proc_resident_size() - (int64_t)residentBefore,
+				  ec ? 0 : (uint64_t)fileBytes);
+	} catch (std::exception &e) {
+		obs_log(LOG_ERROR, "Failed to load tesseract model: %s", e.what());
+		if (api != nullptr) {
+			api->End();
+			delete api;
+		}
+		return nullptr;
+	}
+	return std::make_unique<TesseractEngine>(api, settings.language, variant);
+}
@@ -3,21 +3,28 @@
 #include "obs-utils.h"
 #include "consts.h"
 #include "text-render-helper.h"
+#include "text-detection.h"
+#include "cpu-budget.h"
+#include "result-publisher.h"
+#include "post-processing.h"
+#include "pipeline-trace.h"
+#include "output-targets.h"
+#include "frame-recording.h"
 
 #include <obs-module.h>
+#include <util/platform.h>
 
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
 
-#include <tesseract/baseapi.h>
-
 #include <inja/inja.hpp>
 
 #include <string>
-#include <fstream>
 #include <deque>
-#include <stdexcept>
 #include <algorithm>
+#include <cmath>
+#include <atomic>
+#include <memory>
 #include <thread>
 
 inline uint64_t get_time_ns(void)
@@ -47,232 +54,658 @@ void cleanup_config_files(const std::string &unique_id)
 	std::filesystem::remove(mask_filepath.c_str());
 }
 
-void initialize_tesseract_ocr(filter_data *tf, bool hard_tesseract_init_required)
+/**
+  * @brief Post-process, validate and smooth a recognized text
+  * @return false if the text was rejected by validation, it isn't added to the smoothing history
+*/
+static bool finalize_ocr_result(filter_data *tf, const PostProcessor &postProcessor,
+				std::string &recognitionResult)
 {
-	try {
-		std::lock_guard<std::mutex> lock(tf->tesseract_settings_mutex);
-
-		if (hard_tesseract_init_required) {
-			stop_and_join_tesseract_thread(tf);
-			if (tf->tesseract_model != nullptr) {
-				tf->tesseract_model->End();
-				delete tf->tesseract_model;
-				tf->tesseract_model = nullptr;
-			}
-		}
+	// strip whitespace from the beginning and end of the string
+	recognitionResult = strip(recognitionResult);
 
-		char **configs = nullptr;
-		int configs_size = 0;
+	if (!postProcessor.process(recognitionResult)) {
+		return false;
+	}
 
-		if (is_valid_output_source_name(tf->output_image_source_name)) {
-			// make sure mask folder exists
-			check_plugin_config_folder_exists();
-		}
+	if (tf->smoothing_filter) {
+		recognitionResult = tf->smoothing_filter->add_reading(recognitionResult);
+	}
 
-		// if the user patterns are not empty, apply them
-		if (!tf->user_patterns.empty()) {
-			check_plugin_config_folder_exists();
-			// save the user patterns to a file in the module's config folder
-			std::string filename = "user-patterns-" + tf->unique_id + ".txt";
-			std::string user_patterns_filepath =
-				obs_module_config_path(filename.c_str());
-			obs_log(LOG_INFO, "Saving user patterns to: %s",
-				user_patterns_filepath.c_str());
-			std::ofstream user_patterns_file(user_patterns_filepath);
-			user_patterns_file << tf->user_patterns;
-			user_patterns_file.close();
-
-			// create a .config file pointing to the patterns file
-			filename = "user-patterns" + tf->unique_id + ".config";
-			std::string patterns_config_filepath =
-				obs_module_config_path(filename.c_str());
-			obs_log(LOG_INFO, "Saving user patterns config to: %s",
-				patterns_config_filepath.c_str());
-			std::ofstream patterns_config_file(patterns_config_filepath);
-			patterns_config_file << "user_patterns_file " << user_patterns_filepath
-					     << "\n";
-			patterns_config_file.close();
-
-			// add the config file to the configs array
-			configs_size = 1;
-			configs = new char *[configs_size];
-			configs[0] = new char[patterns_config_filepath.length() + 1];
-			strcpy(configs[0], patterns_config_filepath.c_str());
-		}
+	return true;
+}
 
-		if (hard_tesseract_init_required) {
-			obs_log(LOG_INFO, "Loading tesseract model from: %s",
-				tf->tesseractTraineddataFilepath);
+static cv::Rect scale_rect(const cv::Rect &rect, double scale)
+{
+	return cv::Rect((int)((double)rect.x * scale), (int)((double)rect.y * scale),
+			(int)((double)rect.width * scale), (int)((double)rect.height * scale));
+}
 
-			tf->tesseract_model = new tesseract::TessBaseAPI();
+/**
+  * @brief The outputs of one recognized frame
+*/
+struct ocr_output {
+	// the snapshot the frame was recognized with, outputs are sent with it
+	std::shared_ptr<const ocr_settings> settings;
+	// the result for the signal and proc handler consumers
+	ocr_result_event result;
+	// formatted text, empty if there is nothing to send
+	std::string text;
+	// detection mask or text overlay, empty without an image output
+	cv::Mat image;
+};
+
+/**
+  * @brief An engine being created and warmed up on a background thread
+*/
+struct engine_load {
+	std::thread thread;
+	// the snapshot whose engine is being loaded
+	std::shared_ptr<const ocr_settings> settings;
+	std::atomic<bool> done{false};
+	std::unique_ptr<OcrEngine> engine;
+	uint64_t start_time_ns = 0;
+	uint64_t load_time_ns = 0;
+	uint64_t warm_up_time_ns = 0;
+};
+
+/**
+  * @brief State owned by the worker thread, buffers persist across frames
+*/
+struct ocr_worker_state {
+	inja::Environment env;
+	PreprocessingPipeline pipeline;
+	cv::Mat previewScratch;
+	TextLineDetector line_detector;
+	// whether the last frame had too many lines for the text detection prepass
+	bool prepass_full_page = false;
+	PostProcessor post_processor;
+	// the recognition engine, only used by the worker
+	std::unique_ptr<OcrEngine> engine;
+	// the snapshot the engine is currently configured with
+	std::shared_ptr<const ocr_settings> applied;
+	// engine loading in the background, the current engine keeps serving meanwhile
+	std::unique_ptr<engine_load> loading;
+	// the snapshot the last finished load was for, whether it succeeded or not
+	std::shared_ptr<const ocr_settings> loaded;
+	// set when a new engine was swapped in, until it delivered its first result
+	uint64_t switch_start_time_ns = 0;
+	// outputs held back in synchronized output mode, oldest frame first
+	std::deque<ocr_output> delayed_outputs;
+	// auto-ROI: area around the last result in crop coordinates, empty to scan the full crop
+	cv::Rect roi;
+	int frames_since_full_roi = 0;
+	// layout cache: text lines of the last full analysis in crop coordinates
+	std::vector<cv::Rect> layout_lines;
+	cv::Size layout_size;
+	int frames_since_layout = 0;
+	// auto-scale: text height of the last confident result in crop pixels, 0 if unknown, and
+	// the factor the resize stages currently use
+	int text_height = 0;
+	double auto_scale = 0.0;
+	// recognitions abandoned at the deadline, and the downscaled image of their retry
+	uint64_t timed_out_frames = 0;
+	cv::Mat retryScratch;
+	// shared-memory / socket publisher for external consumers, null when not publishing
+	std::unique_ptr<ResultPublisher> publisher;
+	// additional text outputs fed from the same result
+	OutputFanOut fan_out;
+	// frames recorded for a replay, and the settings version last written to the recording
+	FrameRecordingWriter recorder;
+	std::string recording_path;
+	uint64_t recorded_settings_version = 0;
+};
+
+/**
+  * @brief Pick the resize factor that brings the text to the target height, from the last
+  * result's boxes or a projection profile of the image when there is none
+*/
+static void update_auto_scale(ocr_worker_state &state, const ocr_settings &settings,
+			      const cv::Mat &roiGray)
+{
+	const int text_height =
+		state.text_height > 0 ? state.text_height : estimate_text_height(roiGray);
+	if (text_height <= 0) {
+		// nothing that looks like text, keep the last factor
+		return;
+	}
+	double scale = std::clamp((double)settings.preprocessing.rescaleTargetSize /
+					  (double)text_height,
+				  0.25, 4.0);
+	if (std::abs(scale - 1.0) < 0.1) {
+		// close enough, skip the resize
+		scale = 1.0;
+	}
+	// small changes would only add a new resampling table and jitter the glyph size
+	if (state.auto_scale > 0.0 && std::abs(scale / state.auto_scale - 1.0) < 0.15) {
+		return;
+	}
+	obs_log(LOG_DEBUG, "Auto-scale: text height %d px, scale %.2f", text_height, scale);
+	state.auto_scale = scale;
+}
 
-			// Load model
-			int retval = tf->tesseract_model->Init(tf->tesseractTraineddataFilepath,
-							       tf->language.c_str(),
-							       tesseract::OEM_LSTM_ONLY, configs,
-							       configs_size, nullptr, nullptr,
-							       false);
-			if (retval != 0) {
-				throw std::runtime_error("Failed to initialize tesseract model");
-			}
+static bool needs_engine_load(const ocr_worker_state &state, const ocr_settings &settings)
+{
+	return !state.loaded || ocr_engine_changed(*state.loaded, settings);
+}
+
+static void start_engine_load(filter_data *tf, ocr_worker_state &state,
+			      const std::shared_ptr<const ocr_settings> &settings)
+{
+	state.loading = std::make_unique<engine_load>();
+	engine_load *load = state.loading.get();
+	load->settings = settings;
+	load->start_time_ns = get_time_ns();
+	load->thread = std::thread([tf, load] {
+		uint64_t budget_version = 0;
+		apply_cpu_budget_to_current_thread(budget_version);
+		load->engine = create_ocr_engine(tf, *load->settings);
+		const uint64_t loaded_time_ns = get_time_ns();
+		load->load_time_ns = loaded_time_ns - load->start_time_ns;
+		if (load->engine) {
+			load->engine->warm_up();
+			load->warm_up_time_ns = get_time_ns() - loaded_time_ns;
 		}
+		load->done = true;
+		// wake the worker so that the swap doesn't wait for the update timer
+		tf->tesseract_thread_cv.notify_all();
+	});
+}
 
-		// set tesseract page segmentation mode
-		tf->tesseract_model->SetPageSegMode(
-			static_cast<tesseract::PageSegMode>(tf->pageSegmentationMode));
+/**
+  * @brief Swap in a finished background load, or start over if the settings moved on while it
+  * was loading
+*/
+static void poll_engine_load(filter_data *tf, ocr_worker_state &state)
+{
+	if (!state.loading || !state.loading->done) {
+		return;
+	}
+	std::unique_ptr<engine_load> load = std::move(state.loading);
+	load->thread.join();
+	state.loaded = load->settings;
 
-		// apply char whitlist
-		tf->tesseract_model->SetVariable("tessedit_char_whitelist",
-						 tf->char_whitelist.c_str());
+	if (ocr_engine_changed(*load->settings, *state.applied)) {
+		start_engine_load(tf, state, state.applied);
+		return;
+	}
+	if (!load->engine) {
+		// keep the previous engine, if any, a later settings change retries
+		return;
+	}
 
-		if (tf->enable_smoothing) {
-			tf->smoothing_filter = std::make_unique<CharacterBasedSmoothingFilter>(
-				tf->word_length, tf->window_size);
-		}
+	load->engine->configure(*state.applied);
+	state.engine = std::move(load->engine);
+	state.switch_start_time_ns = load->start_time_ns;
+	obs_log(LOG_INFO, "%s engine ready: load %.1f ms, warm-up %.1f ms", state.engine->name(),
+		(double)load->load_time_ns / 1e6, (double)load->warm_up_time_ns / 1e6);
+}
 
-		if (hard_tesseract_init_required) {
-			// start the thread
-			std::thread new_thread(tesseract_thread, tf);
-			tf->tesseract_thread.swap(new_thread);
-		}
-	} catch (std::exception &e) {
-		obs_log(LOG_ERROR, "Failed to load tesseract model: %s", e.what());
+static void cancel_engine_load(ocr_worker_state &state)
+{
+	if (!state.loading) {
 		return;
 	}
+	// model loading can't be interrupted, wait for it and throw the result away
+	state.loading->thread.join();
+	state.loading.reset();
 }
 
-std::string strip(const std::string &str)
+/**
+  * @brief Bring the engine in line with a new settings snapshot, only touching the parts that
+  * changed since the previously applied one
+*/
+static void apply_ocr_settings(filter_data *tf, ocr_worker_state &state,
+			       const std::shared_ptr<const ocr_settings> &next)
 {
-	size_t start = str.find_first_not_of(" \t\n\r");
-	size_t end = str.find_last_not_of(" \t\n\r");
+	const ocr_settings *previous = state.applied.get();
+	obs_log(LOG_DEBUG, "Applying settings version %llu", (unsigned long long)next->version);
+
+	// a different engine or model is loaded in the background while the current engine
+	// keeps serving
+	if (!state.loading && needs_engine_load(state, *next)) {
+		start_engine_load(tf, state, next);
+	}
+	if (state.engine) {
+		state.engine->configure(*next);
+	}
+
+	// the smoothing history is only dropped when its shape changes
+	if (!next->enable_smoothing) {
+		tf->smoothing_filter.reset();
+	} else if (!tf->smoothing_filter || !previous || !previous->enable_smoothing ||
+		   previous->word_length != next->word_length ||
+		   previous->window_size != next->window_size) {
+		tf->smoothing_filter = std::make_unique<CharacterBasedSmoothingFilter>(
+			next->word_length, next->window_size);
+	}
+
+	state.pipeline.configure(next->preprocessingStages, next->preprocessing);
+	state.post_processor.configure(next->postprocess_replacements, next->postprocess_rules,
+				       next->validation_pattern);
+	state.fan_out.configure(next->output_targets);
+
+	// the start of the filter's uuid by default, so that filters don't share a ring or socket
+	// and the shared memory name stays short enough for macOS
+	const std::string publish_name = next->publish_name.empty()
+						 ? tf->unique_id.substr(0, 8)
+						 : next->publish_name;
+	if (!next->publish_results) {
+		state.publisher.reset();
+	} else if (!state.publisher || state.publisher->get_name() != publish_name ||
+		   state.publisher->has_socket() != next->publish_socket) {
+		if (next->publish_name.empty()) {
+			obs_log(LOG_INFO, "Publishing results as '%s'", publish_name.c_str());
+		}
+		// release the old name first, the new publisher may reuse it
+		state.publisher.reset();
+		state.publisher =
+			std::make_unique<ResultPublisher>(publish_name, next->publish_socket);
+	}
 
-	if (start == std::string::npos || end == std::string::npos)
-		return "";
+	if (!next->record_frames && state.recorder.is_open()) {
+		state.recorder.close();
+		obs_log(LOG_INFO, "Recorded frames to %s", state.recording_path.c_str());
+	}
 
-	return str.substr(start, end - start + 1);
+	// the crop may have changed, start over from the full crop and a fresh layout
+	state.roi = cv::Rect();
+	state.layout_lines.clear();
+	state.applied = next;
 }
 
-std::string run_tesseract_ocr(filter_data *tf, const cv::Mat &image)
+/**
+  * @brief Append a processed frame to the recording, started in the module config folder with
+  * the first frame
+*/
+static void record_frame(filter_data *tf, ocr_worker_state &state, const ocr_settings &settings,
+			 const cv::Mat &imageGray, uint64_t timestampNs)
 {
-	std::lock_guard<std::mutex> lock(tf->tesseract_settings_mutex);
+	TraceScope scope("record");
+	if (!state.recorder.is_open()) {
+		if (state.recorded_settings_version == settings.version) {
+			// failed to start with these settings, try again after the next change
+			return;
+		}
+		check_plugin_config_folder_exists();
+		const std::string format = "recording-%CCYY%MM%DD-%hh%mm%ss-" + tf->unique_id;
+		char *filename = os_generate_formatted_filename("ocrrec", true, format.c_str());
+		char *path = obs_module_config_path(filename);
+		state.recording_path = path;
+		bfree(path);
+		bfree(filename);
+		state.recorded_settings_version = settings.version;
+		if (!state.recorder.open(state.recording_path)) {
+			obs_log(LOG_ERROR, "Failed to start a recording in %s",
+				state.recording_path.c_str());
+			return;
+		}
+		obs_log(LOG_INFO, "Recording frames to %s", state.recording_path.c_str());
+		state.recorder.write_settings(settings.settings_json, timestampNs);
+	}
+	if (settings.version != state.recorded_settings_version) {
+		state.recorder.write_settings(settings.settings_json, timestampNs);
+		state.recorded_settings_version = settings.version;
+	}
+	state.recorder.write_frame(imageGray, timestampNs);
+}
 
-	// run the tesseract model
-	tf->tesseract_model->SetImage(image.data, image.cols, image.rows, image.channels(),
-				      (int)image.step);
-	char *text = tf->tesseract_model->GetUTF8Text();
-	if (text == nullptr) {
-		return "";
+/**
+  * @brief Run recognition on one frame and fill in its outputs
+  * @return false if the frame was skipped because it didn't change or its text was rejected
+*/
+static bool process_frame(filter_data *tf, ocr_worker_state &state, const ocr_settings &settings,
+			  cv::Mat &imageGray, cv::Point cropOffset, ocr_output &output)
+{
+	// if update on change is true check if the image has changed
+	// unless a recognition was triggered through the proc handler
+	const bool triggered = tf->ocr_triggered.exchange(false);
+	if (settings.update_on_change && !triggered &&
+	    imageGray.size() == tf->lastInputGray.size() &&
+	    !frame_changed(imageGray, tf->lastInputGray, settings.update_on_change_threshold)) {
+		// if the image has not changed, skip the processing
+		return false;
+	}
+	imageGray.copyTo(tf->lastInputGray);
+	if (settings.record_frames) {
+		record_frame(tf, state, settings, imageGray, output.result.frame_timestamp_ns);
 	}
-	std::string recognitionResult = std::string(text);
-	delete[] text;
 
-	// get the confidence of the recognition result
-	const int confidence = tf->tesseract_model->MeanTextConf();
+	// with auto-ROI only the area around the last result is processed, the full crop is
+	// scanned again periodically and whenever the text was lost
+	const bool auto_roi = settings.auto_roi && settings.ocr_engine != OCR_ENGINE_SEVEN_SEGMENT;
+	cv::Rect roi(0, 0, imageGray.cols, imageGray.rows);
+	if (auto_roi && state.roi.area() > 0 &&
+	    state.frames_since_full_roi < settings.auto_roi_refresh_frames) {
+		roi &= state.roi;
+		state.frames_since_full_roi++;
+	} else {
+		state.frames_since_full_roi = 0;
+	}
+	const cv::Mat roiGray = imageGray(roi);
 
-	if (confidence < tf->conf_threshold) {
-		return "";
+	if (settings.auto_rescale) {
+		update_auto_scale(state, settings, roiGray);
+	}
+	state.pipeline.set_scale(settings.auto_rescale ? state.auto_scale : 0.0);
+	const cv::Mat &imageForOCR = state.pipeline.process(roiGray);
+
+	if (settings.previewBinarization) {
+		// lock the outputPreviewBGRALock
+		std::lock_guard<std::mutex> lock(tf->outputPreviewBGRALock);
+		const cv::Mat *preview = &imageForOCR;
+		if (imageForOCR.size() != imageGray.size()) {
+			// the preview is drawn over the source
+			cv::resize(imageForOCR, state.previewScratch, imageGray.size(), 0, 0,
+				   cv::INTER_NEAREST);
+			preview = &state.previewScratch;
+		}
+		cv::cvtColor(*preview, tf->outputPreviewBGRA, cv::COLOR_GRAY2BGRA);
 	}
 
-	// strip whitespace from the beginning and end of the string
-	recognitionResult = strip(recognitionResult);
+	// Process the image
+	// boxes are in OCR image coordinates, outputs are at crop size
+	double box_scale = (double)roi.width / (double)imageForOCR.cols;
+	const bool wantImageOutput =
+		is_valid_output_source_name(settings.output_image_source_name.c_str());
+	ocr_request request;
+	request.image = imageForOCR;
+	request.scale = 1.0 / box_scale;
+	// the boxes are also published with the ocr_result signal
+	request.wantBoxes = true;
+	request.deadlineMs = settings.recognition_deadline_ms;
+	std::vector<cv::Rect> lines;
+	const bool layout_cache =
+		settings.layout_cache && settings.ocr_engine == OCR_ENGINE_TESSERACT;
+	bool usedCachedLayout = false;
+	if (settings.textDetectionPrepass && settings.ocr_engine != OCR_ENGINE_SEVEN_SEGMENT) {
+		// only recognize the candidate lines, one by one
+		lines = state.line_detector.detect(roiGray);
+		const bool too_many_lines = state.line_detector.too_many_lines();
+		if (too_many_lines != state.prepass_full_page) {
+			obs_log(LOG_INFO,
+				too_many_lines ? "Text detection found too many lines, recognizing "
+						 "the full image until there are fewer"
+					       : "Text detection recognizes line by line again");
+			state.prepass_full_page = too_many_lines;
+		}
+		for (cv::Rect &line : lines) {
+			line = scale_rect(line, request.scale);
+		}
+		if (!too_many_lines) {
+			request.lines = &lines;
+		}
+	} else if (layout_cache && !state.layout_lines.empty() &&
+		   state.layout_size == imageGray.size() &&
+		   state.frames_since_layout < settings.layout_refresh_frames) {
+		// skip the layout analysis, recognize the known lines in single line mode
+		for (const cv::Rect &line : state.layout_lines) {
+			const cv::Rect visible = line & roi;
+			if (visible.area() > 0) {
+				lines.push_back(scale_rect(visible - roi.tl(), request.scale));
+			}
+		}
+		request.lines = &lines;
+		usedCachedLayout = true;
+		state.frames_since_layout++;
+	} else if (layout_cache) {
+		// full analysis, keep the lines it finds for the next frames
+		request.wantLines = true;
+	}
+	ocr_engine_result result;
+	{
+		TraceScope scope("recognize");
+		if (!state.engine->recognize(request, settings, result)) {
+			obs_log(LOG_ERROR, "%s recognition failed", state.engine->name());
+		}
+	}
+	if (result.timedOut && settings.deadline_retry && request.image.cols >= 2 &&
+	    request.image.rows >= 2) {
+		// a smaller image recognizes faster, at some cost in accuracy on small text
+		TraceScope scope("recognize retry");
+		cv::resize(request.image, state.retryScratch, cv::Size(), 0.5, 0.5, cv::INTER_AREA);
+		request.image = state.retryScratch;
+		request.scale *= 0.5;
+		box_scale *= 2.0;
+		for (cv::Rect &line : lines) {
+			line = scale_rect(line, 0.5);
+		}
+		result = ocr_engine_result();
+		if (!state.engine->recognize(request, settings, result)) {
+			obs_log(LOG_ERROR, "%s recognition failed", state.engine->name());
+		}
+	}
+	if (result.timedOut) {
+		state.timed_out_frames++;
+		obs_log(LOG_DEBUG, "Recognition passed the %u ms deadline, %llu frames so far",
+			settings.recognition_deadline_ms,
+			(unsigned long long)state.timed_out_frames);
+		// don't let update on change skip the same frame, it is read again next time
+		tf->lastInputGray.release();
+		return false;
+	}
+	std::string ocr_result = result.text;
+	bool rejected = false;
+	if (!ocr_result.empty()) {
+		TraceScope scope("post-process");
+		rejected = !finalize_ocr_result(tf, state.post_processor, ocr_result);
+	}
 
-	if (tf->enable_smoothing) {
-		recognitionResult = tf->smoothing_filter->add_reading(recognitionResult);
+	// boxes in crop coordinates
+	std::vector<OCRBox> &boxes = result.boxes;
+	for (OCRBox &box : boxes) {
+		box.box = scale_rect(box.box, box_scale) + roi.tl();
 	}
 
-	return recognitionResult;
-}
+	if (request.wantLines) {
+		const cv::Rect bounds(0, 0, imageGray.cols, imageGray.rows);
+		state.layout_lines.clear();
+		for (const cv::Rect &line : result.lines) {
+			// some slack around the tight line boxes for small movements
+			const int pad = line.height / 5 + 2;
+			const cv::Rect padded(line.x - pad, line.y - pad, line.width + 2 * pad,
+					      line.height + 2 * pad);
+			state.layout_lines.push_back((scale_rect(padded, box_scale) + roi.tl()) &
+						     bounds);
+		}
+		state.layout_size = imageGray.size();
+		state.frames_since_layout = 0;
+		obs_log(LOG_DEBUG, "Layout analysis found %d lines",
+			(int)state.layout_lines.size());
+	} else if (usedCachedLayout && result.boxes.size() * 2 < lines.size()) {
+		// most of the known lines no longer read confidently, the layout changed
+		obs_log(LOG_DEBUG, "Layout change detected, analyzing the next frame");
+		state.layout_lines.clear();
+	}
 
-std::vector<OCRBox> extract_text_detection_boxes(filter_data *tf, cv::Size imageSize)
-{
-	// extract the text detection boxes
-	tesseract::ResultIterator *ri = tf->tesseract_model->GetIterator();
-	if (ri == nullptr) {
-		return std::vector<OCRBox>();
-	}
-	tesseract::PageIteratorLevel level = tesseract::RIL_WORD;
-	if (tf->pageSegmentationMode == tesseract::PSM_SINGLE_CHAR) {
-		level = tesseract::RIL_SYMBOL;
-	}
-	std::vector<OCRBox> boxes;
-	do {
-		if (ri->Empty(level)) {
-			continue;
+	if (settings.auto_rescale) {
+		// word boxes of a confident read measure the text better than the profile
+		std::vector<int> heights;
+		if (!rejected && result.confidence >= settings.conf_threshold) {
+			for (const OCRBox &box : boxes) {
+				heights.push_back(box.box.height);
+			}
 		}
-		// is this a word box?
-		if (level == tesseract::RIL_WORD) {
-			// get the confidence of the word
-			float conf = ri->Confidence(level);
-			if ((int)conf < tf->conf_threshold) {
-				continue;
+		state.text_height = 0;
+		if (!heights.empty()) {
+			const auto median = heights.begin() + (ptrdiff_t)(heights.size() / 2);
+			std::nth_element(heights.begin(), median, heights.end());
+			state.text_height = *median;
+		}
+	}
+
+	if (auto_roi) {
+		if (rejected || result.text.empty() ||
+		    result.confidence < settings.conf_threshold) {
+			// lost the text, scan the full crop next frame
+			state.roi = cv::Rect();
+		} else if (!boxes.empty()) {
+			cv::Rect found = boxes.front().box;
+			for (const OCRBox &box : boxes) {
+				found |= box.box;
 			}
+			const int margin = settings.auto_roi_margin;
+			found = cv::Rect(found.x - margin, found.y - margin,
+					 found.width + 2 * margin, found.height + 2 * margin);
+			state.roi = found & cv::Rect(0, 0, imageGray.cols, imageGray.rows);
 		}
-		OCRBox box;
-		int left, top, right, bottom;
-		ri->BoundingBox(level, &left, &top, &right, &bottom);
-		box.box = cv::Rect(left, top, right - left, bottom - top);
-		// get the text of the box
-		const char *text = ri->GetUTF8Text(level);
-		box.text = text;
-		// get area of box
-		const int area = (right - left) * (bottom - top);
-		// if the area is too small or too big, relative to the image size - skip the box
-		if (area < 100 || area > (imageSize.width * imageSize.height) / 2) {
-			continue;
+		obs_log(LOG_DEBUG, "Auto-ROI processed %.0f%% of the crop",
+			100.0 * (double)roi.area() / (double)(imageGray.cols * imageGray.rows));
+	}
+
+	if (rejected) {
+		// keep the previous outputs rather than showing an invalid read
+		obs_log(LOG_DEBUG, "OCR result failed validation: %s", ocr_result.c_str());
+		return false;
+	}
+
+	if (wantImageOutput) {
+		cv::Mat text_detection_output(imageGray.rows, imageGray.cols, CV_8UC4,
+					      cv::Scalar(0, 0, 0, 0));
+
+		if (settings.output_image_option == OUTPUT_IMAGE_OPTION_DETECTION_MASK) {
+			text_detection_output.setTo(cv::Scalar(0, 0, 0, 255));
+
+			// Create a text detection binary mask
+			for (const auto &box : boxes) {
+				cv::rectangle(text_detection_output, box.box,
+					      cv::Scalar(255, 255, 255, 255), -1);
+			}
+		} else {
+			// Create a text overlay image
+			QImage text_overlay_image = render_boxes_with_qtextdocument(
+				boxes, imageGray.cols, imageGray.rows,
+				settings.output_image_option ==
+					OUTPUT_IMAGE_OPTION_TEXT_BACKGROUND);
+			cv::Mat text_overlay_image_mat(text_overlay_image.height(),
+						       text_overlay_image.width(), CV_8UC4,
+						       text_overlay_image.bits(),
+						       text_overlay_image.bytesPerLine());
+			text_overlay_image_mat.copyTo(text_detection_output);
 		}
-		boxes.push_back(box);
-	} while (ri->Next(level));
-	delete ri;
 
-	return boxes;
+		output.image = text_detection_output;
+	}
+
+	if (!ocr_result.empty() &&
+	    is_valid_output_source_name(settings.output_source_name.c_str())) {
+		// If an output source is selected - send the results there
+		output.text = format_text_with_template(state.env, ocr_result,
+							settings.output_format_template,
+							output.result.frame_timestamp_ns);
+	}
+
+	output.result.text = ocr_result;
+	output.result.confidence = result.confidence;
+	output.result.boxes = boxes;
+	for (OCRBox &box : output.result.boxes) {
+		box.box += cropOffset;
+	}
+	return true;
 }
 
-CharacterBasedSmoothingFilter::CharacterBasedSmoothingFilter(size_t word_length_,
-							     size_t window_size_)
-	: word_length(word_length_),
-	  window_size(window_size_),
-	  readings(word_length_, std::deque<char>(window_size_))
+static void send_ocr_output(filter_data *tf, ocr_worker_state &state, const ocr_output &output)
 {
+	TraceScope scope("output");
+	if (!output.image.empty()) {
+		setTextDetectionMaskCallback(output.image, *output.settings, tf);
+	}
+	if (!output.text.empty()) {
+		setTextCallback(output.text, *output.settings, tf);
+	}
+	if (!output.result.text.empty() && !state.fan_out.empty()) {
+		state.fan_out.send(state.env, output.result.text, output.result.frame_timestamp_ns);
+	}
+	emitOcrResultSignal(tf, output.result);
+	if (state.publisher) {
+		state.publisher->publish(output.result);
+	}
+	obs_log(LOG_DEBUG, "OCR frame-to-output latency: %.1f ms",
+		(double)(os_gettime_ns() - output.result.frame_timestamp_ns) / 1e6);
 }
 
-std::string CharacterBasedSmoothingFilter::add_reading(const std::string &inWord)
+static uint64_t output_due_time_ns(const ocr_output &output)
 {
-	std::string word = inWord;
-	if (word.length() != word_length) {
-		// trim the word if it's longer than the expected length
-		if (word.length() > this->word_length)
-			word = word.substr(0, this->word_length);
-		// pad the word if it's shorter than the expected length
-		if (word.length() < this->word_length)
-			word = word + std::string(this->word_length - word.length(), ' ');
-	}
-
-	std::string smoothed_word;
-	for (size_t i = 0; i < word_length; i++) {
-		readings[i].push_back(word[i]);
-		if (readings[i].size() > window_size) {
-			readings[i].pop_front();
+	return output.result.frame_timestamp_ns +
+	       (uint64_t)output.settings->sync_latency_ms * 1000000;
+}
+
+/**
+  * @brief Send the held back outputs whose frame reached the configured latency, or all of them
+  * when synchronized output was turned off
+*/
+static void send_due_outputs(filter_data *tf, ocr_worker_state &state)
+{
+	const bool sync_output = state.applied && state.applied->sync_output;
+	while (!state.delayed_outputs.empty()) {
+		const ocr_output &output = state.delayed_outputs.front();
+		if (sync_output && output_due_time_ns(output) > os_gettime_ns()) {
+			return;
 		}
-		std::string window(readings[i].begin(), readings[i].end());
-		// find the most common character in the window
-		char most_common_char =
-			*std::max_element(window.begin(), window.end(), [window](char a, char b) {
-				return std::count(window.begin(), window.end(), a) <
-				       std::count(window.begin(), window.end(), b);
-			});
-		smoothed_word += most_common_char;
+		send_ocr_output(tf, state, output);
+		state.delayed_outputs.pop_front();
 	}
+}
 
-	return smoothed_word;
+static void queue_ocr_output(filter_data *tf, ocr_worker_state &state, ocr_output output)
+{
+	if (!output.settings->sync_output) {
+		send_ocr_output(tf, state, output);
+		return;
+	}
+	if (output_due_time_ns(output) <= os_gettime_ns()) {
+		obs_log(LOG_DEBUG, "OCR result is later than the %u ms output latency",
+			output.settings->sync_latency_ms);
+	}
+	// bounded, a huge latency with a short update timer would otherwise pile up frames
+	if (state.delayed_outputs.size() >= 64) {
+		state.delayed_outputs.pop_front();
+	}
+	state.delayed_outputs.push_back(std::move(output));
+	send_due_outputs(tf, state);
 }
 
-std::string format_text_with_template(inja::Environment &env, const std::string &text,
-				      struct filter_data *tf)
+/**
+  * @brief Sleep until the next frame is due, sending held back outputs on time meanwhile.
+  * Returns early when the worker is notified.
+*/
+static void wait_for_next_frame(filter_data *tf, ocr_worker_state &state, uint64_t next_frame_ns)
 {
-	// Replace the {{output}} placeholder with the source text using inja
-	nlohmann::json data;
-	data["output"] = text;
-	return env.render(tf->output_format_template, data);
+	while (true) {
+		send_due_outputs(tf, state);
+		const uint64_t now_ns = os_gettime_ns();
+		if (now_ns >= next_frame_ns) {
+			return;
+		}
+		uint64_t wake_ns = next_frame_ns;
+		if (!state.delayed_outputs.empty()) {
+			const uint64_t output_due_ns =
+				output_due_time_ns(state.delayed_outputs.front());
+			wake_ns = std::min(wake_ns, output_due_ns);
+		}
+		std::unique_lock<std::mutex> lock(tf->tesseract_mutex);
+		if (!tf->tesseract_thread_run) {
+			return;
+		}
+		const std::chrono::nanoseconds timeout(std::max(wake_ns, now_ns) - now_ns);
+		if (tf->tesseract_thread_cv.wait_for(lock, timeout) == std::cv_status::no_timeout) {
+			return;
+		}
+	}
+}
+
+void start_tesseract_thread(struct filter_data *tf)
+{
+	{
+		std::lock_guard<std::mutex> lock(tf->tesseract_mutex);
+		if (tf->tesseract_thread_run) {
+			return;
+		}
+		// set before the thread exists so that a stop request can't be missed
+		tf->tesseract_thread_run = true;
+	}
+	std::thread new_thread(tesseract_thread, tf);
+	tf->tesseract_thread.swap(new_thread);
 }
 
 void stop_and_join_tesseract_thread(struct filter_data *tf)
@@ -291,19 +724,78 @@ void stop_and_join_tesseract_thread(struct filter_data *tf)
 	}
 }
 
-// Tesseract thread function
-void tesseract_thread(void *data)
+void notify_tesseract_thread(struct filter_data *tf)
 {
-	filter_data *tf = reinterpret_cast<filter_data *>(data);
+	// notifying under the lock makes sure a flag change isn't missed by a parking worker
+	std::lock_guard<std::mutex> lock(tf->tesseract_mutex);
+	tf->tesseract_thread_cv.notify_all();
+}
+
+/**
+  * @brief Drop the frame buffers and park the worker until the filter is used again or stopped.
+  * No frame is processed and no timer runs while parked.
+*/
+static void park_tesseract_thread(filter_data *tf, ocr_worker_state &state)
+{
+	obs_log(LOG_INFO, "OCR filter idle, parking the Tesseract thread");
 
+	// the last captured frame is stale by the time the filter resumes
 	{
-		std::lock_guard<std::mutex> lock(tf->tesseract_mutex);
-		tf->tesseract_thread_run = true;
+		std::lock_guard<std::mutex> lock(tf->inputGrayLock);
+		tf->inputGray.release();
+	}
+	{
+		std::lock_guard<std::mutex> lock(tf->outputPreviewBGRALock);
+		tf->outputPreviewBGRA.release();
+	}
+	tf->lastInputGray.release();
+	state.previewScratch.release();
+	state.delayed_outputs.clear();
+	state.roi = cv::Rect();
+	state.layout_lines.clear();
+	state.line_detector = TextLineDetector();
+	state.prepass_full_page = false;
+	state.pipeline = PreprocessingPipeline();
+	if (state.applied) {
+		state.pipeline.configure(state.applied->preprocessingStages,
+					 state.applied->preprocessing);
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(tf->tesseract_mutex);
+		tf->tesseract_thread_cv.wait(
+			lock, [tf] { return !tf->tesseract_thread_run || !is_filter_idle(tf); });
 	}
+	obs_log(LOG_INFO, "OCR filter resumed");
+}
 
-	obs_log(LOG_INFO, "Starting Tesseract thread, update timer: %d", tf->update_timer_ms);
+/**
+  * @brief Ask the render thread for the next frame and wait for it
+  * @return false if none came within the timeout, e.g. while the source isn't rendered
+*/
+static bool request_frame(filter_data *tf, uint32_t timeout_ms)
+{
+	const uint64_t sequence = tf->inputFrameSequence.load();
+	tf->frameRequested = true;
+	std::unique_lock<std::mutex> lock(tf->tesseract_mutex);
+	const bool delivered = tf->tesseract_thread_cv.wait_for(
+		lock, std::chrono::milliseconds(timeout_ms), [tf, sequence] {
+			return tf->inputFrameSequence.load() != sequence ||
+			       !tf->tesseract_thread_run;
+		});
+	tf->frameRequested = false;
+	return delivered && tf->inputFrameSequence.load() != sequence;
+}
 
-	inja::Environment env;
+// Tesseract thread function
+void tesseract_thread(void *data)
+{
+	filter_data *tf = reinterpret_cast<filter_data *>(data);
+
+	obs_log(LOG_INFO, "Starting Tesseract thread");
+
+	ocr_worker_state state;
+	uint64_t budget_version = 0;
 
 	while (true) {
 		{
@@ -313,179 +805,82 @@ void tesseract_thread(void *data)
 			}
 		}
 
+		if (is_filter_idle(tf)) {
+			park_tesseract_thread(tf, state);
+			continue;
+		}
+
+		apply_cpu_budget_to_current_thread(budget_version);
+
 		// time the operation
 		uint64_t request_start_time_ns = get_time_ns();
 
+		// pick up the latest settings, the snapshot stays valid for the whole frame
+		const std::shared_ptr<const ocr_settings> settings = get_ocr_settings(tf);
+		if (settings && settings != state.applied) {
+			apply_ocr_settings(tf, state, settings);
+		}
+		poll_engine_load(tf, state);
+		trace_set_thread_filter(settings && settings->enable_tracing ? tf->trace_id : 0,
+					"OCR worker");
+
 		// Send the image to the Tesseract OCR model
-		cv::Mat imageBGRA;
-		{
-			std::unique_lock<std::mutex> lock(tf->inputBGRALock, std::try_to_lock);
-			if (lock.owns_lock()) {
-				imageBGRA = tf->inputBGRA.clone();
-			}
+		cv::Mat imageGray;
+		cv::Point cropOffset;
+		ocr_output output;
+		if (settings && state.engine &&
+		    request_frame(tf, std::min<uint32_t>(settings->update_timer_ms, 500))) {
+			std::lock_guard<std::mutex> lock(tf->inputGrayLock);
+			imageGray = tf->inputGray.clone();
+			cropOffset = tf->inputCropOffset;
+			output.result.frame_timestamp_ns = tf->inputTimestampNs;
 		}
 
-		if (!imageBGRA.empty()) {
+		if (!imageGray.empty()) {
+			bool processed = false;
+			// with a thread cap a busy plugin drops this frame rather than queueing it,
+			// the wait is bounded so that stopping the filter isn't held up
+			OcrSlot slot(std::chrono::milliseconds(
+				std::min<uint32_t>(settings->update_timer_ms, 500)));
 			try {
-				// if there is any crop region set, apply it
-				cv::Rect2i cropRegion(
-					tf->cropRegionRelative.x, tf->cropRegionRelative.y,
-					imageBGRA.cols + tf->cropRegionRelative.width,
-					imageBGRA.rows + tf->cropRegionRelative.height);
-				if (cropRegion.width < imageBGRA.cols ||
-				    cropRegion.height < imageBGRA.rows) {
-					imageBGRA = imageBGRA(cropRegion).clone();
-				}
-
-				// if update on change is true check if the image has changed
-				if (tf->update_on_change &&
-				    imageBGRA.size() == tf->lastInputBGRA.size()) {
-					const int change_threshold_from_image_area =
-						(int)((float)tf->update_on_change_threshold /
-						      100.0f *
-						      (float)(imageBGRA.cols * imageBGRA.rows));
-					// if the image has not changed, skip the processing
-					// take the absolute difference between the images, convert to gray and count the non-zero pixels
-					cv::Mat diff;
-					cv::absdiff(imageBGRA, tf->lastInputBGRA, diff);
-					cv::cvtColor(diff, diff, cv::COLOR_BGRA2GRAY);
-					if (cv::countNonZero(diff) <
-					    change_threshold_from_image_area) {
-						// skip the processing
-						continue;
-					}
-				}
-				tf->lastInputBGRA = imageBGRA.clone();
-
-				cv::Mat imageForOCR = imageBGRA.clone();
-
-				// if threshold is requested, apply it
-				if (tf->binarizationMode != 0) {
-					cv::Mat gray;
-					cv::cvtColor(imageForOCR, gray, cv::COLOR_BGRA2GRAY);
-
-					if (tf->binarizationMode == 1)
-						cv::threshold(gray, imageForOCR,
-							      tf->binarizationThreshold, 255,
-							      cv::THRESH_BINARY);
-					else if (tf->binarizationMode == 2 ||
-						 tf->binarizationMode == 3) {
-						// ensure that the block size is odd
-						int block_size = tf->binarizationBlockSize;
-						if (tf->binarizationBlockSize % 2 == 0) {
-							block_size++;
-						}
-						if (tf->binarizationMode == 2) {
-							cv::adaptiveThreshold(
-								gray, imageForOCR, 255,
-								cv::ADAPTIVE_THRESH_MEAN_C,
-								cv::THRESH_BINARY, block_size, 2);
-						} else {
-							cv::adaptiveThreshold(
-								gray, imageForOCR, 255,
-								cv::ADAPTIVE_THRESH_GAUSSIAN_C,
-								cv::THRESH_BINARY, block_size, 2);
-						}
-					} else if (tf->binarizationMode == 4)
-						cv::threshold(gray, imageForOCR, 0, 255,
-							      cv::THRESH_BINARY |
-								      cv::THRESH_TRIANGLE);
-					else if (tf->binarizationMode == 5)
-						cv::threshold(gray, imageForOCR, 0, 255,
-							      cv::THRESH_BINARY | cv::THRESH_OTSU);
-				}
-
-				if (tf->dilationIterations > 0) {
-					cv::Mat element = cv::getStructuringElement(cv::MORPH_RECT,
-										    cv::Size(3, 3));
-					cv::dilate(imageForOCR, imageForOCR, element,
-						   cv::Point(-1, -1), tf->dilationIterations);
-				}
-
-				if (tf->previewBinarization) {
-					// lock the outputPreviewBGRALock
-					std::lock_guard<std::mutex> lock(tf->outputPreviewBGRALock);
-					if (imageForOCR.channels() == 4) {
-						imageForOCR.copyTo(tf->outputPreviewBGRA);
-					} else {
-						cv::cvtColor(imageForOCR, tf->outputPreviewBGRA,
-							     cv::COLOR_GRAY2BGRA);
-					}
-				}
-
-				if (tf->rescaleImage) {
-					// scale to height tf->rescaleTargetSize maintaining aspect ratio
-					cv::Mat resized;
-					float scale = (float)tf->rescaleTargetSize /
-						      (float)imageForOCR.rows;
-					cv::resize(imageForOCR, resized, cv::Size(), scale, scale);
-					imageForOCR = resized;
-				}
-
-				// Process the image
-				std::string ocr_result = run_tesseract_ocr(tf, imageForOCR);
-
-				if (is_valid_output_source_name(tf->output_image_source_name)) {
-					cv::Mat text_detection_output(imageBGRA.rows,
-								      imageBGRA.cols, CV_8UC4,
-								      cv::Scalar(0, 0, 0, 0));
-
-					// Extract the text detection boxes
-					std::vector<OCRBox> boxes =
-						extract_text_detection_boxes(tf, imageBGRA.size());
-
-					if (tf->output_image_option ==
-					    OUTPUT_IMAGE_OPTION_DETECTION_MASK) {
-						text_detection_output.setTo(
-							cv::Scalar(0, 0, 0, 255));
-
-						// Create a text detection binary mask
-						for (const auto &box : boxes) {
-							cv::rectangle(
-								text_detection_output, box.box,
-								cv::Scalar(255, 255, 255, 255), -1);
-						}
-					} else {
-						// Create a text overlay image
-						QImage text_overlay_image = render_boxes_with_qtextdocument(
-							boxes, imageBGRA.cols, imageBGRA.rows,
-							tf->output_image_option ==
-								OUTPUT_IMAGE_OPTION_TEXT_BACKGROUND);
-						cv::Mat text_overlay_image_mat(
-							text_overlay_image.height(),
-							text_overlay_image.width(), CV_8UC4,
-							text_overlay_image.bits(),
-							text_overlay_image.bytesPerLine());
-						text_overlay_image_mat.copyTo(
-							text_detection_output);
-					}
-
-					setTextDetectionMaskCallback(text_detection_output, tf);
-				}
-
-				if (!ocr_result.empty() &&
-				    is_valid_output_source_name(tf->output_source_name)) {
-					// If an output source is selected - send the results there
-					ocr_result = format_text_with_template(env, ocr_result, tf);
-					setTextCallback(ocr_result, tf);
+				if (slot.acquired()) {
+					TraceScope scope("frame");
+					processed = process_frame(tf, state, *settings, imageGray,
+								  cropOffset, output);
 				}
 			} catch (const std::exception &e) {
 				obs_log(LOG_ERROR, "%s", e.what());
 			}
+			if (processed) {
+				output.settings = settings;
+				queue_ocr_output(tf, state, std::move(output));
+			}
+			if (processed && state.switch_start_time_ns != 0) {
+				const uint64_t switch_time_ns =
+					get_time_ns() - state.switch_start_time_ns;
+				obs_log(LOG_INFO,
+					"Time to first result after model switch: %.1f ms",
+					(double)switch_time_ns / 1e6);
+				state.switch_start_time_ns = 0;
+			}
 		}
 
-		// time the request, calculate the remaining time and sleep
+		// time the request, calculate the remaining time and sleep, also after a skipped
+		// frame so that an unchanged image doesn't spin the thread
 		const uint64_t request_end_time_ns = get_time_ns();
 		const uint64_t request_time_ns = request_end_time_ns - request_start_time_ns;
+		const uint32_t update_timer_ms = settings ? settings->update_timer_ms : 1000;
 		const int64_t sleep_time_ms =
-			(int64_t)(tf->update_timer_ms) - (int64_t)(request_time_ns / 1000000);
+			(int64_t)(update_timer_ms) - (int64_t)(request_time_ns / 1000000);
 		if (sleep_time_ms > 0) {
-			std::unique_lock<std::mutex> lock(tf->tesseract_mutex);
 			// Sleep for n ns as per the update timer for the remaining time
-			tf->tesseract_thread_cv.wait_for(lock,
-							 std::chrono::milliseconds(sleep_time_ms));
+			wait_for_next_frame(tf, state,
+					    os_gettime_ns() + (uint64_t)sleep_time_ms * 1000000);
+		} else {
+			send_due_outputs(tf, state);
 		}
 	}
+	cancel_engine_load(state);
 	obs_log(LOG_INFO, "Stopping Tesseract thread");
 
 	{
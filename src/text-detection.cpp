@@ -0,0 +1,119 @@
+#include "text-detection.h"
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+
+namespace {
+
+// detection runs at most at this width, text lines survive the downscale
+constexpr int DETECTION_MAX_WIDTH = 960;
+// gradients weaker than this are noise on a flat background, not glyph edges
+constexpr double MIN_GRADIENT = 24.0;
+constexpr int MIN_LINE_HEIGHT = 6;
+// taller and narrower than this is a rule or a border, not a glyph
+constexpr int MAX_HEIGHT_TO_WIDTH = 8;
+// more lines than this recognize faster as one page than one by one
+constexpr size_t MAX_LINES = 32;
+
+int center_y(const cv::Rect &r)
+{
+	return r.y + r.height / 2;
+}
+
+} // namespace
+
+const std::vector<cv::Rect> &TextLineDetector::detect(const cv::Mat &image)
+{
+	lines.clear();
+	tooManyLines = false;
+	if (image.empty()) {
+		return lines;
+	}
+
+	const cv::Mat *src = &image;
+	if (image.channels() != 1) {
+		cv::cvtColor(image, gray,
+			     image.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+		src = &gray;
+	}
+	double scale = 1.0;
+	if (src->cols > DETECTION_MAX_WIDTH) {
+		scale = (double)DETECTION_MAX_WIDTH / (double)src->cols;
+		cv::resize(*src, small, cv::Size(), scale, scale, cv::INTER_AREA);
+		src = &small;
+	}
+
+	if (gradientElement.empty()) {
+		gradientElement = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(3, 3));
+		closeElement = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(9, 1));
+	}
+	cv::morphologyEx(*src, gradient, cv::MORPH_GRADIENT, gradientElement);
+	const double otsu =
+		cv::threshold(gradient, binary, 0, 255, cv::THRESH_BINARY | cv::THRESH_OTSU);
+	if (otsu < MIN_GRADIENT) {
+		cv::threshold(gradient, binary, MIN_GRADIENT, 255, cv::THRESH_BINARY);
+	}
+	cv::morphologyEx(binary, binary, cv::MORPH_CLOSE, closeElement);
+
+	const int count = cv::connectedComponentsWithStats(binary, labels, stats, centroids, 8,
+							   CV_32S);
+	const cv::Rect bounds(0, 0, image.cols, image.rows);
+	words.clear();
+	for (int i = 1; i < count; i++) {
+		const int width = stats.at<int>(i, cv::CC_STAT_WIDTH);
+		const int height = stats.at<int>(i, cv::CC_STAT_HEIGHT);
+		const int area = stats.at<int>(i, cv::CC_STAT_AREA);
+		// specks, sparse outlines and vertical rules never reach the merge
+		if (height < MIN_LINE_HEIGHT || width < MIN_LINE_HEIGHT / 2 ||
+		    area * 10 < width * height || height > width * MAX_HEIGHT_TO_WIDTH) {
+			continue;
+		}
+		// back to image coordinates, padded so that glyph edges aren't cut
+		const int pad = std::max(2, (int)((double)height / scale * 0.15));
+		cv::Rect line((int)((double)stats.at<int>(i, cv::CC_STAT_LEFT) / scale) - pad,
+			      (int)((double)stats.at<int>(i, cv::CC_STAT_TOP) / scale) - pad,
+			      (int)((double)width / scale) + 2 * pad,
+			      (int)((double)height / scale) + 2 * pad);
+		words.push_back(line & bounds);
+	}
+
+	// merge the words of each line in one sweep: a row band is a run of words, in order of
+	// their vertical centre, centred within the first word's height. Within a band, words
+	// left to right join the line before them if the gap is smaller than the text height
+	std::sort(words.begin(), words.end(), [](const cv::Rect &a, const cv::Rect &b) {
+		return center_y(a) < center_y(b);
+	});
+	for (size_t start = 0; start < words.size();) {
+		const int band_bottom = words[start].y + words[start].height;
+		size_t end = start + 1;
+		while (end < words.size() && center_y(words[end]) < band_bottom) {
+			end++;
+		}
+		std::sort(words.begin() + (long)start, words.begin() + (long)end,
+			  [](const cv::Rect &a, const cv::Rect &b) { return a.x < b.x; });
+		cv::Rect line = words[start];
+		for (size_t i = start + 1; i < end; i++) {
+			const cv::Rect &word = words[i];
+			if (word.x - (line.x + line.width) < std::min(line.height, word.height)) {
+				line |= word;
+			} else {
+				lines.push_back(line);
+				line = word;
+			}
+		}
+		lines.push_back(line);
+		start = end;
+	}
+
+	tooManyLines = lines.size() > MAX_LINES;
+	if (tooManyLines) {
+		lines.clear();
+		return lines;
+	}
+	std::sort(lines.begin(), lines.end(), [](const cv::Rect &a, const cv::Rect &b) {
+		return a.y != b.y ? a.y < b.y : a.x < b.x;
+	});
+	return lines;
+}
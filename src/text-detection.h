@@ -0,0 +1,44 @@
+#ifndef TEXT_DETECTION_H
+#define TEXT_DETECTION_H
+
+#include <opencv2/core/mat.hpp>
+
+#include <vector>
+
+/**
+  * @brief Cheap text line detector used as a prepass before Tesseract.
+  *
+  * Finds candidate lines with a morphological gradient, an Otsu threshold, a horizontal closing
+  * that joins characters into lines and connected components. Buffers persist across frames.
+*/
+class TextLineDetector {
+public:
+	/**
+	  * @brief Detect text lines in a BGRA or grayscale image
+	  * @return Line rectangles in image coordinates, sorted top to bottom, valid until the
+	  * next call. Empty if there are more lines than the prepass handles, see too_many_lines()
+	*/
+	const std::vector<cv::Rect> &detect(const cv::Mat &image);
+
+	/**
+	  * @brief Whether the last image had more lines than recognizing them one by one is worth,
+	  * the whole image should be recognized instead
+	*/
+	bool too_many_lines() const { return tooManyLines; }
+
+private:
+	cv::Mat gray;
+	cv::Mat small;
+	cv::Mat gradient;
+	cv::Mat binary;
+	cv::Mat labels;
+	cv::Mat stats;
+	cv::Mat centroids;
+	cv::Mat gradientElement;
+	cv::Mat closeElement;
+	std::vector<cv::Rect> words;
+	std::vector<cv::Rect> lines;
+	bool tooManyLines = false;
+};
+
+#endif /* TEXT_DETECTION_H */
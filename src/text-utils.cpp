@@ -0,0 +1,151 @@
+#include "text-utils.h"
+
+#include <algorithm>
+#include <vector>
+
+std::string strip(const std::string &str)
+{
+	size_t start = str.find_first_not_of(" \t\n\r");
+	size_t end = str.find_last_not_of(" \t\n\r");
+
+	if (start == std::string::npos || end == std::string::npos)
+		return "";
+
+	return str.substr(start, end - start + 1);
+}
+
+void flatten_text(std::string &str)
+{
+	// remove newlines and tabs, replace with spaces
+	std::replace(str.begin(), str.end(), '\n', ' ');
+	std::replace(str.begin(), str.end(), '\t', ' ');
+	std::replace(str.begin(), str.end(), '\r', ' ');
+
+	// remove multiple spaces
+	str.erase(std::unique(str.begin(), str.end(),
+			      [](char a, char b) { return a == ' ' && b == ' '; }),
+		  str.end());
+}
+
+size_t utf8_prefix_length(const std::string &str, size_t maxBytes)
+{
+	if (str.size() <= maxBytes) {
+		return str.size();
+	}
+	// back off the continuation bytes of the code point the cut falls into
+	size_t length = maxBytes;
+	while (length > 0 && ((unsigned char)str[length] & 0xC0) == 0x80) {
+		length--;
+	}
+	return length;
+}
+
+static std::u32string utf8_to_codepoints(const std::string &str)
+{
+	std::u32string out;
+	for (size_t i = 0; i < str.size();) {
+		const unsigned char c = (unsigned char)str[i];
+		size_t length = 1;
+		char32_t codepoint = c;
+		if ((c & 0xE0) == 0xC0) {
+			length = 2;
+			codepoint = c & 0x1F;
+		} else if ((c & 0xF0) == 0xE0) {
+			length = 3;
+			codepoint = c & 0x0F;
+		} else if ((c & 0xF8) == 0xF0) {
+			length = 4;
+			codepoint = c & 0x07;
+		}
+		for (size_t k = 1; k < length && i + k < str.size(); k++) {
+			codepoint = (codepoint << 6) | ((unsigned char)str[i + k] & 0x3F);
+		}
+		out.push_back(codepoint);
+		i += length;
+	}
+	return out;
+}
+
+static std::string normalize_whitespace(const std::string &str)
+{
+	std::string out;
+	bool pendingSpace = false;
+	for (char c : strip(str)) {
+		if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+			pendingSpace = true;
+			continue;
+		}
+		if (pendingSpace) {
+			out += ' ';
+			pendingSpace = false;
+		}
+		out += c;
+	}
+	return out;
+}
+
+float text_accuracy(const std::string &result, const std::string &expected)
+{
+	const std::u32string a = utf8_to_codepoints(normalize_whitespace(result));
+	const std::u32string b = utf8_to_codepoints(normalize_whitespace(expected));
+	if (a.empty() && b.empty()) {
+		return 1.0f;
+	}
+
+	// Levenshtein distance with a single row
+	std::vector<size_t> row(b.size() + 1);
+	for (size_t j = 0; j <= b.size(); j++) {
+		row[j] = j;
+	}
+	for (size_t i = 1; i <= a.size(); i++) {
+		size_t diagonal = row[0];
+		row[0] = i;
+		for (size_t j = 1; j <= b.size(); j++) {
+			const size_t above = row[j];
+			row[j] = std::min({row[j] + 1, row[j - 1] + 1,
+					   diagonal + (a[i - 1] == b[j - 1] ? 0 : 1)});
+			diagonal = above;
+		}
+	}
+	const size_t distance = row[b.size()];
+	return 1.0f - (float)distance / (float)std::max(a.size(), b.size());
+}
+
+CharacterBasedSmoothingFilter::CharacterBasedSmoothingFilter(size_t word_length_,
+							     size_t window_size_)
+	: word_length(word_length_),
+	  window_size(window_size_),
+	  readings(word_length_, std::deque<char>(window_size_))
+{
+}
+
+std::string CharacterBasedSmoothingFilter::add_reading(const std::string &inWord)
+{
+	std::string word = inWord;
+	if (word.length() != word_length) {
+		// trim the word if it's longer than the expected length
+		if (word.length() > this->word_length)
+			word = word.substr(0, this->word_length);
+		// pad the word if it's shorter than the expected length
+		if (word.length() < this->word_length)
+			word = word + std::string(this->word_length - word.length(), ' ');
+	}
+
+	std::string smoothed_word;
+	for (size_t i = 0; i < word_length; i++) {
+		readings[i].push_back(word[i]);
+		if (readings[i].size() > window_size) {
+			readings[i].pop_front();
+		}
+		std::string window(readings[i].begin(), readings[i].end());
+		// find the most common character in the window
+		char most_common_char =
+			*std::max_element(window.begin(), window.end(), [window](char a, char b) {
+				return std::count(window.begin(), window.end(), a) <
+				       std::count(window.begin(), window.end(), b);
+			});
+		smoothed_word += most_common_char;
+	}
+
+	return smoothed_word;
+}
@@ -0,0 +1,45 @@
+#ifndef TEXT_UTILS_H
+#define TEXT_UTILS_H
+
+#include <deque>
+#include <string>
+#include <vector>
+
+/**
+  * @brief Remove leading and trailing whitespace
+*/
+std::string strip(const std::string &str);
+
+/**
+  * @brief Character-level accuracy (1 - normalized edit distance) of a recognition result,
+  * ignoring leading/trailing whitespace and runs of whitespace.
+*/
+float text_accuracy(const std::string &result, const std::string &expected);
+
+/**
+  * @brief Turn newlines and tabs into spaces and collapse runs of spaces, in place
+*/
+void flatten_text(std::string &str);
+
+/**
+  * @brief Length in bytes of the longest prefix of a UTF-8 string that is at most maxBytes long
+  * and doesn't end in the middle of a code point
+*/
+size_t utf8_prefix_length(const std::string &str, size_t maxBytes);
+
+/**
+  * @brief Per-character majority vote over the last window_size readings of a fixed-length word
+*/
+class CharacterBasedSmoothingFilter {
+public:
+	CharacterBasedSmoothingFilter(size_t word_length, size_t window_size = 10);
+
+	std::string add_reading(const std::string &word);
+
+private:
+	size_t word_length;
+	size_t window_size;
+	std::vector<std::deque<char>> readings;
+};
+
+#endif /* TEXT_UTILS_H */
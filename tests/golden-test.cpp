@@ -0,0 +1,403 @@
+/*
+ * Golden frame regression test: recognizes every case of a manifest with the bundled models
+ * through the plugin's preprocessing pipeline and Tesseract engine, and fails when the accuracy
+ * drops below the case's minimum or the median latency exceeds its budget.
+ *
+ * Usage: ocr-golden-test <cases.json> --tessdata <dir> [--model <name>] [--iterations <n>]
+ *                        [--check accuracy|latency] [--calibrate] [--write-frames <dir>]
+ *
+ * Accuracy is deterministic. Latency depends on the machine: the budgets are medians measured
+ * on a reference machine, scaled for others with OCR_GOLDEN_LATENCY_SCALE, e.g. 2.5, and
+ * ctest labels those tests "perf" so that shared runners can skip them with -LE perf.
+ * --calibrate prints the measured accuracy and median of every case with the thresholds to put
+ * in the manifest, and never fails.
+ */
+
+#include <obs-module.h>
+#include <plugin-support.h>
+
+#include "consts.h"
+#include "filter-data.h"
+#include "ocr-engine.h"
+#include "preprocessing-pipeline.h"
+#include "tesseract-ocr-utils.h"
+
+#include <QImage>
+#include <QString>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <inja/inja.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+OBS_DECLARE_MODULE()
+
+namespace {
+
+struct golden_case {
+	std::string name;
+	std::string model;
+	cv::Mat imageBGRA;
+	std::string expected;
+	int pageSegmentationMode = 3;
+	std::string charWhitelist;
+	std::string preprocessing;
+	preprocessing_params params;
+	int confThreshold = 0;
+	float minAccuracy = 1.0f;
+	double maxMedianMs = 0.0;
+};
+
+/**
+  * @brief Dark text on white with OpenCV's Hershey font, one line per '\n'
+*/
+cv::Mat render_text(const std::string &text, int height)
+{
+	std::vector<std::string> lines;
+	std::stringstream ss(text);
+	for (std::string line; std::getline(ss, line);) {
+		lines.push_back(line);
+	}
+	const int font = cv::FONT_HERSHEY_SIMPLEX;
+	const double scale = (double)height / 22.0;
+	const int thickness = std::max(1, height / 12);
+	const int lineHeight = height * 8 / 5;
+	int width = 0;
+	for (const std::string &line : lines) {
+		int baseline = 0;
+		const cv::Size size = cv::getTextSize(line, font, scale, thickness, &baseline);
+		width = std::max(width, size.width);
+	}
+	const int margin = height;
+	cv::Mat image(lineHeight * (int)lines.size() + 2 * margin - (lineHeight - height),
+		      width + 2 * margin, CV_8UC4, cv::Scalar(255, 255, 255, 255));
+	for (size_t i = 0; i < lines.size(); i++) {
+		const cv::Point origin(margin, margin + height + (int)i * lineHeight);
+		cv::putText(image, lines[i], origin, font, scale, cv::Scalar(0, 0, 0, 255),
+			    thickness, cv::LINE_AA);
+	}
+	return image;
+}
+
+/**
+  * @brief Light seven-segment digits on black, like a scoreboard. Supports 0-9, ':', '.' and ' '.
+*/
+cv::Mat render_seven_segment(const std::string &text, int height)
+{
+	// segments a-g as bits 0-6
+	static const int digitSegments[10] = {0x3F, 0x06, 0x5B, 0x4F, 0x66,
+					      0x6D, 0x7D, 0x07, 0x7F, 0x6F};
+	const int digitWidth = height * 11 / 20;
+	const int thickness = std::max(3, height / 8);
+	const int spacing = thickness * 3 / 2;
+	const int margin = height / 2;
+
+	int width = 0;
+	for (char c : text) {
+		width += (c == ':' || c == '.' ? 2 * thickness : digitWidth) + spacing;
+	}
+	cv::Mat image(height + 2 * margin, width - spacing + 2 * margin, CV_8UC4,
+		      cv::Scalar(0, 0, 0, 255));
+	const cv::Scalar lit(40, 200, 255, 255);
+
+	// a bar with pointed ends between two points on a horizontal or vertical line
+	auto segment = [&](cv::Point from, cv::Point to) {
+		const int h = thickness / 2;
+		const int gap = thickness / 4;
+		std::vector<cv::Point> polygon;
+		if (from.y == to.y) {
+			from.x += gap;
+			to.x -= gap;
+			polygon = {from,
+				   {from.x + h, from.y - h},
+				   {to.x - h, to.y - h},
+				   to,
+				   {to.x - h, to.y + h},
+				   {from.x + h, from.y + h}};
+		} else {
+			from.y += gap;
+			to.y -= gap;
+			polygon = {from,
+				   {from.x + h, from.y + h},
+				   {to.x + h, to.y - h},
+				   to,
+				   {to.x - h, to.y - h},
+				   {from.x - h, from.y + h}};
+		}
+		cv::fillConvexPoly(image, polygon, lit, cv::LINE_AA);
+	};
+
+	int x = margin;
+	for (char c : text) {
+		if (c == ':') {
+			for (int y : {margin + height / 3, margin + height * 2 / 3}) {
+				cv::rectangle(image,
+					      cv::Rect(x + thickness / 2, y - thickness / 2,
+						       thickness, thickness),
+					      lit, cv::FILLED);
+			}
+			x += 2 * thickness + spacing;
+			continue;
+		}
+		if (c == '.') {
+			const int y = margin + height - thickness / 2;
+			cv::rectangle(image,
+				      cv::Rect(x + thickness / 2, y - thickness / 2, thickness,
+					       thickness),
+				      lit, cv::FILLED);
+			x += 2 * thickness + spacing;
+			continue;
+		}
+		if (c >= '0' && c <= '9') {
+			const int segments = digitSegments[c - '0'];
+			const int left = x + thickness / 2;
+			const int right = x + digitWidth - thickness / 2;
+			const int top = margin + thickness / 2;
+			const int middle = margin + height / 2;
+			const int bottom = margin + height - thickness / 2;
+			const cv::Point ends[7][2] = {
+				{{left, top}, {right, top}},
+				{{right, top}, {right, middle}},
+				{{right, middle}, {right, bottom}},
+				{{left, bottom}, {right, bottom}},
+				{{left, middle}, {left, bottom}},
+				{{left, top}, {left, middle}},
+				{{left, middle}, {right, middle}},
+			};
+			for (int s = 0; s < 7; s++) {
+				if (segments & (1 << s)) {
+					segment(ends[s][0], ends[s][1]);
+				}
+			}
+		}
+		x += digitWidth + spacing;
+	}
+	return image;
+}
+
+cv::Mat load_png(const std::string &path)
+{
+	QImage image(QString::fromStdString(path));
+	if (image.isNull()) {
+		return cv::Mat();
+	}
+	image = image.convertToFormat(QImage::Format_ARGB32);
+	return cv::Mat(image.height(), image.width(), CV_8UC4, image.bits(),
+		       (size_t)image.bytesPerLine())
+		.clone();
+}
+
+bool load_cases(const std::string &manifestPath, const std::string &model,
+		std::vector<golden_case> &cases)
+{
+	std::ifstream file(manifestPath);
+	if (!file.is_open()) {
+		fprintf(stderr, "Failed to open %s\n", manifestPath.c_str());
+		return false;
+	}
+	const std::filesystem::path folder = std::filesystem::path(manifestPath).parent_path();
+	nlohmann::json manifest;
+	try {
+		manifest = nlohmann::json::parse(file);
+	} catch (const std::exception &e) {
+		fprintf(stderr, "Failed to parse %s: %s\n", manifestPath.c_str(), e.what());
+		return false;
+	}
+
+	for (const nlohmann::json &entry : manifest["cases"]) {
+		golden_case c;
+		c.name = entry.value("name", "");
+		c.model = entry.value("model", "eng");
+		if (!model.empty() && c.model != model) {
+			continue;
+		}
+		c.pageSegmentationMode = entry.value("psm", 3);
+		c.charWhitelist = entry.value("whitelist", "");
+		c.preprocessing = entry.value("preprocessing", "");
+		// without a mode the threshold stage passes its input through
+		c.params.binarizationMode = entry.value("binarization_mode", 0);
+		c.params.binarizationThreshold = entry.value("binarization_threshold", 127);
+		c.params.binarizationBlockSize = entry.value("block_size", 15);
+		c.confThreshold = entry.value("conf_threshold", 0);
+		c.minAccuracy = entry.value("min_accuracy", 1.0f);
+		c.maxMedianMs = entry.value("max_median_ms", 0.0);
+
+		if (entry.contains("image")) {
+			// a captured frame, with the expected text next to it like the auto-tuner
+			// samples
+			std::filesystem::path imagePath = folder / entry.value("image", "");
+			c.imageBGRA = load_png(imagePath.string());
+			std::ifstream expected(imagePath.replace_extension(".txt"));
+			std::stringstream text;
+			text << expected.rdbuf();
+			c.expected = text.str();
+		} else {
+			// a frame rendered from the expected text
+			c.expected = entry.value("text", "");
+			const int height = entry.value("height", 32);
+			c.imageBGRA = entry.value("render", "text") == "seven_segment"
+					      ? render_seven_segment(c.expected, height)
+					      : render_text(c.expected, height);
+		}
+		if (c.imageBGRA.empty()) {
+			fprintf(stderr, "%s: no frame\n", c.name.c_str());
+			return false;
+		}
+		cases.push_back(c);
+	}
+	return true;
+}
+
+struct golden_options {
+	std::string tessdata = "data/tessdata";
+	int iterations = 10;
+	bool checkAccuracy = true;
+	bool checkLatency = true;
+	bool calibrate = false;
+};
+
+/**
+  * @brief Recognize one case iterations times
+  * @return true if it passed
+*/
+bool run_case(const golden_case &c, const golden_options &options)
+{
+	ocr_settings settings;
+	// the seven_segment "model" is the geometric decoder, the others are Tesseract models
+	settings.ocr_engine =
+		c.model == "seven_segment" ? OCR_ENGINE_SEVEN_SEGMENT : OCR_ENGINE_TESSERACT;
+	settings.language = c.model;
+	settings.pageSegmentationMode = c.pageSegmentationMode;
+	settings.char_whitelist = c.charWhitelist;
+	settings.conf_threshold = c.confThreshold;
+	settings.preprocessingStages = parse_preprocessing_stages(c.preprocessing);
+	settings.preprocessing = c.params;
+
+	filter_data tf;
+	std::string tessdataPath = options.tessdata;
+	tf.tesseractTraineddataFilepath = &tessdataPath[0];
+	tf.unique_id = "golden-test";
+	std::unique_ptr<OcrEngine> engine = create_ocr_engine(&tf, settings);
+	tf.tesseractTraineddataFilepath = nullptr;
+	if (!engine) {
+		printf("FAIL %s: failed to load model %s\n", c.name.c_str(), c.model.c_str());
+		return false;
+	}
+	engine->configure(settings);
+	engine->warm_up();
+
+	PreprocessingPipeline pipeline;
+	pipeline.configure(settings.preprocessingStages, settings.preprocessing);
+	// the filter converts every frame to luminance on capture
+	cv::Mat imageGray;
+	cv::cvtColor(c.imageBGRA, imageGray, cv::COLOR_BGRA2GRAY);
+
+	std::vector<double> latencies;
+	std::string text;
+	for (int i = 0; i < options.iterations; i++) {
+		const auto start = std::chrono::steady_clock::now();
+		ocr_request request;
+		request.image = pipeline.process(imageGray);
+		request.scale = (double)request.image.cols / (double)imageGray.cols;
+		ocr_engine_result result;
+		engine->recognize(request, settings, result);
+		text = strip(result.text);
+		latencies.push_back(std::chrono::duration<double, std::milli>(
+					    std::chrono::steady_clock::now() - start)
+					    .count());
+	}
+	std::nth_element(latencies.begin(), latencies.begin() + latencies.size() / 2,
+			 latencies.end());
+	const double medianMs = latencies[latencies.size() / 2];
+	const float accuracy = text_accuracy(text, c.expected);
+
+	if (options.calibrate) {
+		// a read that isn't exact is a finding to look at, not a threshold to lower to
+		printf("CALIBRATE %s: accuracy %.3f, median %.1f ms -> \"min_accuracy\": %.2f, "
+		       "\"max_median_ms\": %.0f, read \"%s\"\n",
+		       c.name.c_str(), accuracy, medianMs, std::floor(accuracy * 100.0f) / 100.0f,
+		       std::ceil(medianMs * 2.0), text.c_str());
+		return true;
+	}
+
+	const char *scaleEnv = getenv("OCR_GOLDEN_LATENCY_SCALE");
+	const double budgetMs = c.maxMedianMs * (scaleEnv != nullptr ? atof(scaleEnv) : 1.0);
+	const bool accurate = !options.checkAccuracy || accuracy >= c.minAccuracy;
+	const bool fast = !options.checkLatency || budgetMs <= 0.0 || medianMs <= budgetMs;
+	printf("%s %s: accuracy %.3f (min %.3f), median %.1f ms (budget %.0f ms), read \"%s\"\n",
+	       accurate && fast ? "PASS" : "FAIL", c.name.c_str(), accuracy, c.minAccuracy,
+	       medianMs, budgetMs, text.c_str());
+	return accurate && fast;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s <cases.json> --tessdata <dir> [--model <name>] "
+				"[--iterations <n>] [--check accuracy|latency] [--calibrate] "
+				"[--write-frames <dir>]\n",
+			argv[0]);
+		return 2;
+	}
+	golden_options options;
+	std::string model;
+	std::string framesFolder;
+	for (int i = 2; i < argc; i++) {
+		const std::string option = argv[i];
+		if (option == "--calibrate") {
+			options.calibrate = true;
+		} else if (i + 1 >= argc) {
+			break;
+		} else if (option == "--tessdata") {
+			options.tessdata = argv[++i];
+		} else if (option == "--model") {
+			model = argv[++i];
+		} else if (option == "--iterations") {
+			options.iterations = std::max(1, atoi(argv[++i]));
+		} else if (option == "--check") {
+			const std::string check = argv[++i];
+			options.checkAccuracy = check != "latency";
+			options.checkLatency = check != "accuracy";
+		} else if (option == "--write-frames") {
+			framesFolder = argv[++i];
+		}
+	}
+
+	std::vector<golden_case> cases;
+	if (!load_cases(argv[1], model, cases)) {
+		return 1;
+	}
+	if (cases.empty()) {
+		fprintf(stderr, "No cases for model '%s'\n", model.c_str());
+		return 1;
+	}
+
+	int failed = 0;
+	for (const golden_case &c : cases) {
+		if (!framesFolder.empty()) {
+			// for inspecting the rendered frames, or turning them into captured ones
+			const std::string path = framesFolder + "/" + c.name + ".png";
+			QImage(c.imageBGRA.data, c.imageBGRA.cols, c.imageBGRA.rows,
+			       (int)c.imageBGRA.step, QImage::Format_ARGB32)
+				.save(QString::fromStdString(path));
+		}
+		if (!run_case(c, options)) {
+			failed++;
+		}
+	}
+	printf("%d of %d cases passed\n", (int)cases.size() - failed, (int)cases.size());
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,58 @@
+/*
+ * Unit test of text_accuracy, the score the auto-tuner ranks configurations by and the golden
+ * frame test compares against its minimums.
+ *
+ * Usage: ocr-text-accuracy-test
+ */
+
+#include "text-utils.h"
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+namespace {
+
+int failures = 0;
+
+void expect_accuracy(const std::string &result, const std::string &expected, float accuracy)
+{
+	const float actual = text_accuracy(result, expected);
+	const bool ok = std::fabs(actual - accuracy) < 1e-4f;
+	printf("%s text_accuracy(\"%s\", \"%s\") = %.4f, expected %.4f\n", ok ? "PASS" : "FAIL",
+	       result.c_str(), expected.c_str(), actual, accuracy);
+	if (!ok) {
+		failures++;
+	}
+}
+
+} // namespace
+
+int main()
+{
+	// exact and empty reads
+	expect_accuracy("12:34", "12:34", 1.0f);
+	expect_accuracy("", "", 1.0f);
+	expect_accuracy("", "105", 0.0f);
+	expect_accuracy("105", "", 0.0f);
+
+	// one edit in n characters costs 1/n, whichever string is longer
+	expect_accuracy("106", "105", 2.0f / 3.0f);
+	expect_accuracy("10", "105", 2.0f / 3.0f);
+	expect_accuracy("1055", "105", 0.75f);
+	expect_accuracy("4:O7", "4:07", 0.75f);
+	expect_accuracy("kitten", "sitting", 1.0f - 3.0f / 7.0f);
+
+	// leading and trailing whitespace is ignored, runs of whitespace compare as one space
+	expect_accuracy("  Round 3\n of 5\r\n", "Round 3 of 5", 1.0f);
+	expect_accuracy("Player One\t1250", "Player One 1250", 1.0f);
+	expect_accuracy("RoundThree", "Round Three", 1.0f - 1.0f / 11.0f);
+
+	// distances count code points, not bytes
+	expect_accuracy("Straße", "Strasse", 1.0f - 2.0f / 7.0f);
+	expect_accuracy("日本語", "日本", 1.0f - 1.0f / 3.0f);
+
+	printf("%s\n", failures == 0 ? "All text accuracy checks passed"
+				     : "Some text accuracy checks failed");
+	return failures == 0 ? 0 : 1;
+}